@@ -37,6 +37,23 @@ static char cpu_color;
 #define RESPONSE_BUFF_SIZE 1000
 static bool no_self_check = true;
 
+// Size of the transposition table in megabytes(0 disables it)
+static unsigned long hash_mb = TT_DEFAULT_MB;
+module_param(hash_mb, ulong, 0444);
+MODULE_PARM_DESC(hash_mb, "Transposition table size in megabytes");
+
+// Bounds on each CPU move's search(0 for none) so a write can't stall for long.
+//  With a bound the search deepens until it runs out, otherwise it stops at 
+//  the default depth. Bounds above the maximums are lowered to them
+#define MAX_MOVE_TIME_MS 10000
+#define MAX_MOVE_NODES 10000000UL
+static unsigned int move_time_ms = 0;
+module_param(move_time_ms, uint, 0644);
+MODULE_PARM_DESC(move_time_ms, "Milliseconds each CPU move may search for(0 for no limit, at most 10000)");
+static unsigned long move_nodes = 0;
+module_param(move_nodes, ulong, 0644);
+MODULE_PARM_DESC(move_nodes, "Nodes each CPU move may search(0 for no limit, at most 10000000)");
+
 static char input_buff[CMD_ARG_OFFSET + MOVE_NOTATION_LENGTH + 1] = {0};
 static byte response_buff[RESPONSE_BUFF_SIZE + 1] = {0};
 
@@ -44,12 +61,19 @@ static byte response_buff[RESPONSE_BUFF_SIZE + 1] = {0};
 static struct proc_dir_entry* proc_entry;
 
 static int __init chess_init(void) {
+	 init_attack_tables();
+	 init_zobrist_keys();
+	 if (!Transposition_Table_init(&transposition_table, hash_mb)){
+	 	printk(KERN_INFO "Chess driver could not allocate its transposition table");
+	 	return -ENOMEM;
+	 }
 	 proc_entry = proc_create(DEVICE_NAME, 0666, NULL, &proc_fops);
 	 printk(KERN_INFO "Chess driver loaded");
 	 return 0;
 }
 static void __exit chess_exit(void) {
 	 proc_remove(proc_entry);
+	 Transposition_Table_free(&transposition_table);
 	 printk(KERN_INFO "Chess driver terminated");
 }
 
@@ -103,6 +127,8 @@ static ssize_t device_write(
 {
 	int i;
 	Move m;
+	Packed_Move pm;
+	Search_Options search_options;
 	int bytes_not_copied;
 	int cmd_len;
 	int j;
@@ -169,8 +195,18 @@ static ssize_t device_write(
 		else if (streq(input_buff, "03", 0, cmd_len)){
 			if (game_started){
 				if (turn == cpu_turn){
-					// Perform the CPU's move
-					m = Chess_Game_cpu_move(&game, cpu_color, false);
+					// Perform the CPU's move, notating it before it changes the board
+					search_options = Search_Options_init0();
+					if (move_time_ms || move_nodes){
+						search_options.depth = MAX_SEARCH_DEPTH;
+						search_options.time_limit_ms = (move_time_ms < MAX_MOVE_TIME_MS) 
+													   ? move_time_ms:MAX_MOVE_TIME_MS;
+						search_options.node_limit = (move_nodes < MAX_MOVE_NODES) 
+													? move_nodes:MAX_MOVE_NODES;
+					}
+					pm = Chess_Game_cpu_move(&game, cpu_color, true, &search_options, NULL);
+					m = Chess_Game_notate_move(&game, pm);
+					Chess_Game_render_packed_move(&game, pm, false, cpu_color);
 					respond(response_iterator, m.notation, MOVE_NOTATION_LENGTH); 
 					response_iterator += MOVE_NOTATION_LENGTH;
 					respond(response_iterator, "\n", 1); response_iterator += 1;
@@ -289,7 +325,7 @@ static ssize_t device_write(
 				player_color = input_buff[3];
 				cpu_color = other_color(input_buff[3]);
 				turn = 0;
-				game = Chess_Game_init2(player_color, cpu_color);
+				Chess_Game_init(&game, player_color, cpu_color);
 				respond(response_iterator, "OK\n", 3);
 			}else{
 				respond(response_iterator, "UNKCMD\n", 7);
@@ -0,0 +1,167 @@
+#include "chess.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+// Usage: ./bench [-d depth] [-T ms] [-N nodes] [-t threads] [-H hash_mb] [-n] [-l] [-f] [-r] [-c]
+//  Searches a fixed set of positions and prints each one's score, depth reached,
+//  node count, time and principal variation(the chosen move first) followed by
+//  the totals and nodes per second.
+//  The transposition table is cleared before every position so runs are repeatable
+//   -d: depth in plies(defaults to DEFAULT_SEARCH_DEPTH, or to MAX_SEARCH_DEPTH
+//    when -T or -N is given)
+//   -T, -N: milliseconds or nodes each position may search for
+//   -t: number of threads searching each position(defaults to 1)
+//   -H: megabytes of transposition table(defaults to TT_DEFAULT_MB)
+//   -n, -l, -f, -r: switch off null move pruning, late move reductions,
+//    futility pruning or razoring
+//   -c: instead compare the totals with everything on, each one switched off
+//    in turn and everything off
+
+typedef struct Bench_Position{
+	const char* placement;
+	char color;
+} Bench_Position;
+
+static const Bench_Position positions[] = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR", WHITE},
+	{"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R", WHITE},
+	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R", WHITE},
+	{"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1", WHITE},
+	{"r2q1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R", BLACK},
+	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8", WHITE},
+	{"6k1/5ppp/8/8/8/8/5PPP/3R2K1", WHITE},
+	{"4k3/8/8/3p4/4P3/8/8/4K3", BLACK}
+};
+#define POSITION_COUNT (sizeof(positions) / sizeof(positions[0]))
+
+double seconds_since(struct timespec* start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+//  Search every position, printing each result unless quiet. Returns the total nodes
+unsigned long long run_bench(const Search_Options* options, bool quiet, double* seconds){
+	Chess_Game game;
+	Search_Report report;
+	char coordinates[COORDINATE_NOTATION_LENGTH + 1];
+	struct timespec start;
+	unsigned long long nodes = 0;
+	unsigned int i;
+	int j;
+	*seconds = 0;
+	for (i=0; i<POSITION_COUNT; ++i){
+		Chess_Game_init(&game, WHITE, BLACK);
+		Chess_Game_load_placement(&game, positions[i].placement);
+		Transposition_Table_clear(&transposition_table);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		Chess_Game_cpu_move(&game, positions[i].color, true, options, &report);
+		*seconds += seconds_since(&start);
+		nodes += report.nodes;
+		if (!quiet){
+			printf(
+				"%-64s %c %6d %2d %10llu %6lums ",
+				positions[i].placement, positions[i].color, report.score, 
+				report.depth, report.nodes, report.time_ms
+			);
+			for (j=0; j<report.pv_length; ++j){
+				Packed_Move_coordinates(report.pv[j], coordinates);
+				printf(" %s", coordinates);
+			}
+			printf("\n");
+		}
+	}
+	return nodes;
+}
+
+void print_comparison_row(const char* label, const Search_Options* options, unsigned long long base_nodes){
+	double seconds;
+	unsigned long long nodes = run_bench(options, true, &seconds);
+	printf(
+		"%-24s %-14llu %-9.3f %.2fx\n",
+		label, nodes, seconds, base_nodes ? (double)nodes / base_nodes:1.0
+	);
+}
+
+int main(int argc, char** argv){
+	Search_Options options = Search_Options_init0();
+	Search_Options variant;
+	long hash_mb = TT_DEFAULT_MB;
+	bool depth_given = false;
+	bool compare = false;
+	unsigned long long nodes;
+	double seconds;
+	int option;
+
+	// Parse the arguments
+	while ((option = getopt(argc, argv, "d:T:N:t:H:nlfrc")) != -1){
+		switch (option){
+			case 'd': options.depth = atoi(optarg); depth_given = true; break;
+			case 'T': options.time_limit_ms = strtoul(optarg, NULL, 10); break;
+			case 'N': options.node_limit = strtoull(optarg, NULL, 10); break;
+			case 't': options.threads = atoi(optarg); break;
+			case 'H': hash_mb = atol(optarg); break;
+			case 'n': options.null_move = false; break;
+			case 'l': options.late_move_reductions = false; break;
+			case 'f': options.futility_pruning = false; break;
+			case 'r': options.razoring = false; break;
+			case 'c': compare = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-d depth] [-T ms] [-N nodes] [-t threads] [-H hash_mb] [-n] [-l] [-f] [-r] [-c]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (!depth_given && (options.time_limit_ms || options.node_limit)){
+		options.depth = MAX_SEARCH_DEPTH;
+	}
+	if (options.depth < 1 || options.depth > MAX_SEARCH_DEPTH){
+		fprintf(stderr, "Depth must be between 1 and %d\n", MAX_SEARCH_DEPTH);
+		return 1;
+	}
+	if (options.threads < 1){
+		fprintf(stderr, "Threads must be at least 1\n");
+		return 1;
+	}
+	if (!Transposition_Table_init(&transposition_table, hash_mb)){
+		fprintf(stderr, "Could not allocate a %ldMB transposition table\n", hash_mb);
+		return 1;
+	}
+
+	// Compare the node counts of each pruning technique switched off against
+	//  everything switched on
+	if (compare){
+		printf("Options                  Nodes          Time(s)   Nodes vs all on\n");
+		nodes = run_bench(&options, true, &seconds);
+		printf("%-24s %-14llu %-9.3f %.2fx\n", "all on", nodes, seconds, 1.0);
+		variant = options;
+		variant.null_move = false;
+		print_comparison_row("no null move", &variant, nodes);
+		variant = options;
+		variant.late_move_reductions = false;
+		print_comparison_row("no late move reductions", &variant, nodes);
+		variant = options;
+		variant.futility_pruning = false;
+		print_comparison_row("no futility pruning", &variant, nodes);
+		variant = options;
+		variant.razoring = false;
+		print_comparison_row("no razoring", &variant, nodes);
+		variant.null_move = variant.late_move_reductions = variant.futility_pruning = false;
+		print_comparison_row("all off", &variant, nodes);
+		Transposition_Table_free(&transposition_table);
+		return 0;
+	}
+
+	// Report each position and the totals
+	nodes = run_bench(&options, false, &seconds);
+	printf("\nNodes: %llu\n", nodes);
+	printf("Depth limit: %d\n", options.depth);
+	printf("Threads: %d\n", options.threads);
+	printf("Time: %.3fs\n", seconds);
+	printf("Nodes/second: %.0f\n", (seconds > 0) ? nodes / seconds:0.0);
+	Transposition_Table_free(&transposition_table);
+	return 0;
+}
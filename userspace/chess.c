@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
 //*/
 
 // Game parameters
@@ -14,6 +15,10 @@
 #define ROW_STARTC '8'
 #define COL_STARTC 'a'
 #define MOVE_NOTATION_LENGTH 13
+#define COORDINATE_NOTATION_LENGTH 5 // Longest move in coordinate notation(a7a8q)
+#define MAX_PIECES (2*BOARD_SIZE) // Per color
+#define UNDO_STACK_SIZE 128 // Deepest line of made moves that can be unmade
+#define MAX_MOVES 256 // Capacity of a Move_List(more than any position generates)
 
 // Player colors
 #define NO_COLOR '*'
@@ -68,6 +73,39 @@
 #define is_valid_rowc(c) (c <= ROW_STARTC && c > ROW_STARTC - BOARD_SIZE)
 #define is_valid_colc(c) (c < COL_STARTC + BOARD_SIZE && c >= COL_STARTC)
 
+// Square & bitboard constants/utilities
+//  Squares are numbered row by row from the top-left(a8) corner,
+//  so square n is board[square_row(n)][square_col(n)] and bit n of a bitboard
+#define SQUARE_COUNT (BOARD_SIZE*BOARD_SIZE)
+#define square_index(row, col) ((row)*BOARD_SIZE + (col))
+#define square_row(sq) ((sq)/BOARD_SIZE)
+#define square_col(sq) ((sq)%BOARD_SIZE)
+#define square_bb(sq) (1ULL << (sq))
+#define bitboard_lsb(bb) __builtin_ctzll(bb)
+#define bitboard_count(bb) __builtin_popcountll(bb)
+
+// Color & rank indices for per-color/per-rank bitboards
+#define WHITE_INDEX 0
+#define BLACK_INDEX 1
+#define color_index(c) ((c == WHITE) ? WHITE_INDEX:BLACK_INDEX)
+#define KING_INDEX 0
+#define QUEEN_INDEX 1
+#define BISHOP_INDEX 2
+#define KNIGHT_INDEX 3
+#define ROOK_INDEX 4
+#define PAWN_INDEX 5
+#define RANK_COUNT 6
+static const char rank_labels[RANK_COUNT] = {KING, QUEEN, BISHOP, KNIGHT, ROOK, PAWN};
+//  Piece codes(small integers indexing the per-rank tables).
+//   Code 0 is the null piece(no rank) and every other code is its rank's index plus 1
+#define NULL_PIECE_CODE 0
+#define PIECE_CODE_COUNT (RANK_COUNT + 1)
+static const unsigned char piece_codes[128] = {
+	[KING] = KING_INDEX + 1, [QUEEN] = QUEEN_INDEX + 1, [BISHOP] = BISHOP_INDEX + 1,
+	[KNIGHT] = KNIGHT_INDEX + 1, [ROOK] = ROOK_INDEX + 1, [PAWN] = PAWN_INDEX + 1
+};
+#define piece_code(rank) (piece_codes[(rank) & 0x7F])
+
 // Movement & Movement Side-Effect labels
 #define MOVEMENT '-'
 #define NO_MOVEMENT '\0'
@@ -92,6 +130,9 @@
 //  byte typedef
 typedef unsigned char byte;
 
+//  bitboard typedef(one bit per square)
+typedef unsigned long long bitboard;
+
 /*  Bool enum
 typedef enum bool{
 	false=0, 
@@ -113,15 +154,80 @@ typedef struct Move{
 	int gain;
 } Move;
 
+//  Packed_Move typedef: the compact move used by the engine internally.
+//   Notation(a Move) is only built for moves crossing the API boundary
+//    bits 0-5: origin square
+//    bits 6-11: destination square
+//    bits 12-14: rank index promoted to(0 when there is no promotion)
+//    bit 15: capture flag
+typedef unsigned short Packed_Move;
+#define NULL_PACKED_MOVE 0
+#define pack_move(from, to, promotion, capture) \
+	((Packed_Move)((from) | ((to) << 6) | ((promotion) << 12) | ((capture) << 15)))
+#define packed_move_from(m) ((m) & 0x3F)
+#define packed_move_to(m) (((m) >> 6) & 0x3F)
+#define packed_move_promotion(m) (((m) >> 12) & 0x7)
+#define packed_move_is_capture(m) (((m) >> 15) & 1)
+
+//  Scored_Move class(a packed move and its gain)
+typedef struct Scored_Move{
+	Packed_Move move;
+	int gain;
+} Scored_Move;
+
+//  Move_List class(every move a side can make from one position)
+typedef struct Move_List{
+	Packed_Move moves[MAX_MOVES];
+	int count;
+} Move_List;
+
+//  Legality_Masks class(what keeps a color's moves from exposing its king)
+typedef struct Legality_Masks{
+	char color;
+	int king_sq; // -1 when the color has no king
+	bitboard checkers; // Enemy pieces attacking the king
+	bitboard check_mask; // Squares a non-king move must land on(everything when not in check)
+	bitboard pinned; // Allies that can only move along the line from the king
+} Legality_Masks;
+
 //  Piece class
 typedef struct Piece{
 	byte color;
 	byte rank;
 } Piece;
 
+//  Undo_Record class(the state Chess_Game_unmake_move restores)
+typedef struct Undo_Record{
+	Packed_Move move;
+	Packed_Move last_move;
+	Piece mover;
+	Piece captured;
+	bool check;
+	char checked_color;
+	bool checkmate;
+	char checkmated_color;
+	char side_to_move;
+	byte king_locs[2][2]; // cpu's then player's
+} Undo_Record;
+
 //  Chess_Game class
 typedef struct Chess_Game{
 	Piece board[BOARD_SIZE][BOARD_SIZE];
+	// Occupancy bitboards kept in sync with `board`
+	bitboard color_bbs[2];
+	bitboard rank_bbs[RANK_COUNT];
+	bitboard occupied;
+	// Attack bookkeeping kept in sync with `board`: the squares each occupant
+	//  attacks, how many pieces of each color attack each square and
+	//  the resulting per-color attacked-square maps
+	bitboard piece_attacks[SQUARE_COUNT];
+	byte attacker_counts[2][SQUARE_COUNT];
+	bitboard attack_maps[2];
+	// Per-color piece lists(square numbers) kept in sync with `board`
+	//  and each occupied square's position within its color's list
+	byte piece_lists[2][MAX_PIECES];
+	byte piece_counts[2];
+	byte piece_list_indices[SQUARE_COUNT];
 	bool check;
 	char checked_color;
 	bool checkmate;
@@ -130,7 +236,23 @@ typedef struct Chess_Game{
 	char cpu_color;
 	int cpu_king_loc[2];
 	int player_king_loc[2];
-	Move last_move;
+	Packed_Move last_move;
+	// State of the game's own pseudo-random number generator(so copies of a game
+	//  can be used from separate threads)
+	unsigned long long rng_state;
+	// The color to move next and the Zobrist key of the position(including it)
+	char side_to_move;
+	unsigned long long key;
+	// Zobrist key of the pawns alone(for the pawn structure table)
+	unsigned long long pawn_key;
+	// Material plus piece-square scores kept in sync with `board`(white's minus 
+	//  black's) and the phase that blends them
+	int midgame_score;
+	int endgame_score;
+	int phase;
+	// Moves made with Chess_Game_make_move that can still be unmade
+	Undo_Record undo_stack[UNDO_STACK_SIZE];
+	int undo_count;
 } Chess_Game;
 
 //  Piece_Attributes class
@@ -141,9 +263,592 @@ typedef struct Piece_Attributes{
 	// Check if a piece can capture [r2][c2] from [r][c]
 	bool (*can_capture)(Chess_Game*, int, int, int, int);  
 	// Find the highest value move for a piece
-	Move (*optimal_move)(Chess_Game*, int, int, byte); 
+	Scored_Move (*optimal_move)(Chess_Game*, int, int, byte); 
 } Piece_Attributes;
 
+// Precomputed leaper & ray tables
+//  Every entry is a constant expression so the tables are filled in at compile time
+//  and shared read-only by every game
+#define square_bb_rc(row, col) \
+	((is_valid_rown(row) && is_valid_coln(col)) \
+	 ? square_bb(square_index(row, col) & (SQUARE_COUNT - 1)):0ULL)
+#define SQUARE_TABLE(f) \
+	f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), \
+	f(8), f(9), f(10), f(11), f(12), f(13), f(14), f(15), \
+	f(16), f(17), f(18), f(19), f(20), f(21), f(22), f(23), \
+	f(24), f(25), f(26), f(27), f(28), f(29), f(30), f(31), \
+	f(32), f(33), f(34), f(35), f(36), f(37), f(38), f(39), \
+	f(40), f(41), f(42), f(43), f(44), f(45), f(46), f(47), \
+	f(48), f(49), f(50), f(51), f(52), f(53), f(54), f(55), \
+	f(56), f(57), f(58), f(59), f(60), f(61), f(62), f(63)
+
+//  Leaper attack sets
+#define KING_ATTACKS(sq) ( \
+	square_bb_rc(square_row(sq) + 1, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) + 1, square_col(sq)) \
+	| square_bb_rc(square_row(sq) + 1, square_col(sq) + 1) \
+	| square_bb_rc(square_row(sq), square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq), square_col(sq) + 1) \
+	| square_bb_rc(square_row(sq) - 1, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) - 1, square_col(sq)) \
+	| square_bb_rc(square_row(sq) - 1, square_col(sq) + 1))
+#define KNIGHT_ATTACKS(sq) ( \
+	square_bb_rc(square_row(sq) + 2, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) + 2, square_col(sq) + 1) \
+	| square_bb_rc(square_row(sq) - 2, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) - 2, square_col(sq) + 1) \
+	| square_bb_rc(square_row(sq) + 1, square_col(sq) - 2) \
+	| square_bb_rc(square_row(sq) + 1, square_col(sq) + 2) \
+	| square_bb_rc(square_row(sq) - 1, square_col(sq) - 2) \
+	| square_bb_rc(square_row(sq) - 1, square_col(sq) + 2))
+#define WHITE_PAWN_ATTACKS(sq) ( \
+	square_bb_rc(square_row(sq) + FORWARD_WHITE, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) + FORWARD_WHITE, square_col(sq) + 1))
+#define BLACK_PAWN_ATTACKS(sq) ( \
+	square_bb_rc(square_row(sq) + FORWARD_BLACK, square_col(sq) - 1) \
+	| square_bb_rc(square_row(sq) + FORWARD_BLACK, square_col(sq) + 1))
+
+static const bitboard king_attack_table[SQUARE_COUNT] = {SQUARE_TABLE(KING_ATTACKS)};
+static const bitboard knight_attack_table[SQUARE_COUNT] = {SQUARE_TABLE(KNIGHT_ATTACKS)};
+static const bitboard pawn_attack_table[2][SQUARE_COUNT] = {
+	{SQUARE_TABLE(WHITE_PAWN_ATTACKS)},
+	{SQUARE_TABLE(BLACK_PAWN_ATTACKS)}
+};
+
+//  Rays(every square in one direction up to the edge of the board).
+//   Directions are ordered like rook_directions followed by bishop_directions
+#define RAY(sq, dr, dc) ( \
+	square_bb_rc(square_row(sq) + 1*(dr), square_col(sq) + 1*(dc)) \
+	| square_bb_rc(square_row(sq) + 2*(dr), square_col(sq) + 2*(dc)) \
+	| square_bb_rc(square_row(sq) + 3*(dr), square_col(sq) + 3*(dc)) \
+	| square_bb_rc(square_row(sq) + 4*(dr), square_col(sq) + 4*(dc)) \
+	| square_bb_rc(square_row(sq) + 5*(dr), square_col(sq) + 5*(dc)) \
+	| square_bb_rc(square_row(sq) + 6*(dr), square_col(sq) + 6*(dc)) \
+	| square_bb_rc(square_row(sq) + 7*(dr), square_col(sq) + 7*(dc)))
+#define RAY_DOWN(sq) RAY(sq, 1, 0)
+#define RAY_UP(sq) RAY(sq, -1, 0)
+#define RAY_RIGHT(sq) RAY(sq, 0, 1)
+#define RAY_LEFT(sq) RAY(sq, 0, -1)
+#define RAY_DOWN_RIGHT(sq) RAY(sq, 1, 1)
+#define RAY_DOWN_LEFT(sq) RAY(sq, 1, -1)
+#define RAY_UP_LEFT(sq) RAY(sq, -1, -1)
+#define RAY_UP_RIGHT(sq) RAY(sq, -1, 1)
+#define DIRECTION_COUNT 8
+#define is_rook_direction(d) (d < 4)
+#define is_vertical_direction(d) (d < 2)
+//   Rays running towards higher square numbers meet their nearest blocker at the lowest bit
+#define is_increasing_direction(d) (d == 0 || d == 2 || d == 4 || d == 5)
+
+static const bitboard ray_table[DIRECTION_COUNT][SQUARE_COUNT] = {
+	{SQUARE_TABLE(RAY_DOWN)},
+	{SQUARE_TABLE(RAY_UP)},
+	{SQUARE_TABLE(RAY_RIGHT)},
+	{SQUARE_TABLE(RAY_LEFT)},
+	{SQUARE_TABLE(RAY_DOWN_RIGHT)},
+	{SQUARE_TABLE(RAY_DOWN_LEFT)},
+	{SQUARE_TABLE(RAY_UP_LEFT)},
+	{SQUARE_TABLE(RAY_UP_RIGHT)}
+};
+static const int opposite_directions[DIRECTION_COUNT] = {1, 0, 3, 2, 6, 7, 4, 5};
+
+//  The direction leading from one square to another(-1 when they aren't aligned)
+int ray_direction(int sq, int sq2){
+	int direction;
+	for (direction=0; direction<DIRECTION_COUNT; ++direction){
+		if (ray_table[direction][sq] & square_bb(sq2)){
+			return direction;
+		}
+	}
+	return -1;
+}
+
+//  The squares strictly between 2 aligned squares(empty when they aren't aligned)
+bitboard between_bb(int sq, int sq2){
+	int direction = ray_direction(sq, sq2);
+	if (direction < 0){
+		return 0;
+	}
+	return ray_table[direction][sq] & ray_table[opposite_directions[direction]][sq2];
+}
+
+//  Board edges(used to trim rays into magic masks)
+#define TOP_ROW_BB 0x00000000000000FFULL
+#define BOTTOM_ROW_BB 0xFF00000000000000ULL
+#define LEFT_COL_BB 0x0101010101010101ULL
+#define RIGHT_COL_BB 0x8080808080808080ULL
+
+//  Attacks along one ray, stopping at(and including) the nearest occupied square
+bitboard ray_attacks(int sq, bitboard occupied, int direction){
+	bitboard attacks = ray_table[direction][sq];
+	bitboard blockers = attacks & occupied;
+	if (blockers){
+		attacks ^= ray_table[direction][
+			is_increasing_direction(direction) 
+			? bitboard_lsb(blockers):(SQUARE_COUNT - 1 - __builtin_clzll(blockers))
+		];
+	}
+	return attacks;
+}
+
+// Pseudo-random numbers(splitmix64)
+//  Every state, including 0, is valid and the same state always yields the same sequence
+unsigned long long random_next(unsigned long long* state){
+	unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Zobrist keys(one random key per color, rank and square plus one for black to move).
+//  A position's key is the XOR of the keys of everything in it, so
+//  adding or removing a piece or passing the move is a single XOR
+unsigned long long zobrist_piece_keys[2][RANK_COUNT][SQUARE_COUNT];
+unsigned long long zobrist_side_key;
+bool zobrist_keys_ready = false;
+
+void init_zobrist_keys(void){
+	// A fixed seed keeps keys(and anything stored by key) the same between runs
+	unsigned long long state = 0;
+	int i, j, k;
+	if (zobrist_keys_ready){
+		return;
+	}
+	for (i=0; i<2; ++i){
+		for (j=0; j<RANK_COUNT; ++j){
+			for (k=0; k<SQUARE_COUNT; ++k){
+				zobrist_piece_keys[i][j][k] = random_next(&state);
+			}
+		}
+	}
+	zobrist_side_key = random_next(&state);
+	zobrist_keys_ready = true;
+}
+
+// Piece-square tables(tapered evaluation).
+//  Each piece scores its material plus a bonus for its square, once for the
+//  midgame and once for the endgame. The evaluation blends the two by the
+//  phase: how much non-pawn material is left(MAX_PHASE at the start)
+#define PAWN_SCORE 100 // Centipawns per point of piece value
+#define MIDGAME 0
+#define ENDGAME 1
+#define MAX_PHASE 24
+static const int phase_weights[RANK_COUNT] = {0, 4, 1, 1, 2, 0};
+//   Square bonuses for white in centipawns(a8 first like the squares).
+//    Black's are the same with the rows mirrored
+static const short piece_square_bonuses[2][RANK_COUNT][SQUARE_COUNT] = {
+	[MIDGAME] = {
+		[KING_INDEX] = {
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-20,-30,-30,-40,-40,-30,-30,-20,
+			-10,-20,-20,-20,-20,-20,-20,-10,
+			 20, 20,  0,  0,  0,  0, 20, 20,
+			 20, 30, 10,  0,  0, 10, 30, 20
+		},
+		[QUEEN_INDEX] = {
+			-20,-10,-10, -5, -5,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5,  5,  5,  5,  0,-10,
+			 -5,  0,  5,  5,  5,  5,  0, -5,
+			  0,  0,  5,  5,  5,  5,  0, -5,
+			-10,  5,  5,  5,  5,  5,  0,-10,
+			-10,  0,  5,  0,  0,  0,  0,-10,
+			-20,-10,-10, -5, -5,-10,-10,-20
+		},
+		[BISHOP_INDEX] = {
+			-20,-10,-10,-10,-10,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5, 10, 10,  5,  0,-10,
+			-10,  5,  5, 10, 10,  5,  5,-10,
+			-10,  0, 10, 10, 10, 10,  0,-10,
+			-10, 10, 10, 10, 10, 10, 10,-10,
+			-10,  5,  0,  0,  0,  0,  5,-10,
+			-20,-10,-10,-10,-10,-10,-10,-20
+		},
+		[KNIGHT_INDEX] = {
+			-50,-40,-30,-30,-30,-30,-40,-50,
+			-40,-20,  0,  0,  0,  0,-20,-40,
+			-30,  0, 10, 15, 15, 10,  0,-30,
+			-30,  5, 15, 20, 20, 15,  5,-30,
+			-30,  0, 15, 20, 20, 15,  0,-30,
+			-30,  5, 10, 15, 15, 10,  5,-30,
+			-40,-20,  0,  5,  5,  0,-20,-40,
+			-50,-40,-30,-30,-30,-30,-40,-50
+		},
+		[ROOK_INDEX] = {
+			  0,  0,  0,  0,  0,  0,  0,  0,
+			  5, 10, 10, 10, 10, 10, 10,  5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			  0,  0,  0,  5,  5,  0,  0,  0
+		},
+		[PAWN_INDEX] = {
+			  0,  0,  0,  0,  0,  0,  0,  0,
+			 50, 50, 50, 50, 50, 50, 50, 50,
+			 10, 10, 20, 30, 30, 20, 10, 10,
+			  5,  5, 10, 25, 25, 10,  5,  5,
+			  0,  0,  0, 20, 20,  0,  0,  0,
+			  5, -5,-10,  0,  0,-10, -5,  5,
+			  5, 10, 10,-20,-20, 10, 10,  5,
+			  0,  0,  0,  0,  0,  0,  0,  0
+		}
+	},
+	//    In the endgame the king joins in and passed pawns race to promote.
+	//     The other pieces keep their midgame bonuses
+	[ENDGAME] = {
+		[KING_INDEX] = {
+			-50,-40,-30,-20,-20,-30,-40,-50,
+			-30,-20,-10,  0,  0,-10,-20,-30,
+			-30,-10, 20, 30, 30, 20,-10,-30,
+			-30,-10, 30, 40, 40, 30,-10,-30,
+			-30,-10, 30, 40, 40, 30,-10,-30,
+			-30,-10, 20, 30, 30, 20,-10,-30,
+			-30,-30,  0,  0,  0,  0,-30,-30,
+			-50,-30,-30,-30,-30,-30,-30,-50
+		},
+		[PAWN_INDEX] = {
+			  0,  0,  0,  0,  0,  0,  0,  0,
+			 80, 80, 80, 80, 80, 80, 80, 80,
+			 50, 50, 50, 50, 50, 50, 50, 50,
+			 30, 30, 30, 30, 30, 30, 30, 30,
+			 20, 20, 20, 20, 20, 20, 20, 20,
+			 10, 10, 10, 10, 10, 10, 10, 10,
+			 10, 10, 10, 10, 10, 10, 10, 10,
+			  0,  0,  0,  0,  0,  0,  0,  0
+		}
+	}
+};
+//   What each piece adds to the midgame and endgame scores(white's minus black's).
+//    Kings carry no material since both sides always have one
+int piece_square_scores[2][2][RANK_COUNT][SQUARE_COUNT];
+bool piece_square_scores_ready = false;
+#define mirror_square(sq) ((sq) ^ (BOARD_SIZE*(BOARD_SIZE - 1)))
+
+void init_piece_square_scores(void){
+	static const int material[RANK_COUNT] = {
+		0, QUEEN_VALUE, BISHOP_VALUE, KNIGHT_VALUE, ROOK_VALUE, PAWN_VALUE
+	};
+	int bonus;
+	int i, j, sq;
+	if (piece_square_scores_ready){
+		return;
+	}
+	for (i=MIDGAME; i<=ENDGAME; ++i){
+		for (j=0; j<RANK_COUNT; ++j){
+			for (sq=0; sq<SQUARE_COUNT; ++sq){
+				bonus = (i == ENDGAME && (j == KING_INDEX || j == PAWN_INDEX))
+						? piece_square_bonuses[ENDGAME][j][sq]
+						: piece_square_bonuses[MIDGAME][j][sq];
+				piece_square_scores[i][WHITE_INDEX][j][sq] = material[j] * PAWN_SCORE + bonus;
+				piece_square_scores[i][BLACK_INDEX][j][mirror_square(sq)] = -(material[j] * PAWN_SCORE + bonus);
+			}
+		}
+	}
+	piece_square_scores_ready = true;
+}
+
+// Transposition table
+//  A table of buckets(one cache line each) of entries indexed by Zobrist key.
+//  Threads read and write it without locks. Each entry stores its key XORed
+//  with its data, so an entry torn by racing writes simply fails to match
+#define CACHE_LINE_SIZE 64
+#define TT_BUCKET_SIZE 4 // Entries per bucket
+#define TT_DEFAULT_MB 16
+//  Bounds a stored score places on the real score
+#define TT_NO_BOUND 0 // Empty entry
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+//  Entry data layout
+//   bits 0-15: best move
+//   bits 16-47: score
+//   bits 48-55: depth
+//   bits 56-57: bound
+//   bits 58-63: age(the search that stored it)
+#define TT_AGE_COUNT 64
+#define tt_pack(move, score, depth, bound, age) ( \
+	(unsigned long long)(move) \
+	| ((unsigned long long)(unsigned int)(score) << 16) \
+	| ((unsigned long long)(depth) << 48) \
+	| ((unsigned long long)(bound) << 56) \
+	| ((unsigned long long)(age) << 58))
+#define tt_move(data) ((Packed_Move)((data) & 0xFFFF))
+#define tt_score(data) ((int)(unsigned int)(((data) >> 16) & 0xFFFFFFFFULL))
+#define tt_depth(data) ((int)(((data) >> 48) & 0xFF))
+#define tt_bound(data) ((int)(((data) >> 56) & 0x3))
+#define tt_age(data) ((int)((data) >> 58))
+//  Memory for tables and other large structures(vmalloc'd in the kernel module)
+#define table_alloc(bytes) aligned_alloc(CACHE_LINE_SIZE, bytes) // bytes must be a multiple of CACHE_LINE_SIZE
+#define table_free(p) free(p)
+
+typedef struct TT_Entry{
+	unsigned long long check; // key ^ data
+	unsigned long long data;
+} TT_Entry;
+
+typedef struct TT_Bucket{
+	TT_Entry entries[TT_BUCKET_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE))) TT_Bucket;
+
+typedef struct Transposition_Table{
+	TT_Bucket* buckets; // Null when the table is disabled
+	unsigned long long bucket_mask;
+	int age;
+} Transposition_Table;
+
+//  What a probe finds
+typedef struct TT_Hit{
+	Packed_Move move;
+	int score;
+	int depth;
+	int bound;
+} TT_Hit;
+
+//  The table shared by every game and search thread
+Transposition_Table transposition_table = {NULL, 0, 0};
+
+void Transposition_Table_clear(Transposition_Table* table){
+	unsigned long long i;
+	int j;
+	if (!table->buckets){
+		return;
+	}
+	for (i=0; i<=table->bucket_mask; ++i){
+		for (j=0; j<TT_BUCKET_SIZE; ++j){
+			table->buckets[i].entries[j].check = table->buckets[i].entries[j].data = 0;
+		}
+	}
+	table->age = 0;
+}
+void Transposition_Table_free(Transposition_Table* table){
+	if (table->buckets){
+		table_free(table->buckets);
+	}
+	table->buckets = NULL;
+	table->bucket_mask = 0;
+}
+//  (Re)size the table to the largest power of 2 number of buckets fitting
+//   in the given megabytes(0 disables it). Returns false when out of memory
+bool Transposition_Table_init(Transposition_Table* table, unsigned long megabytes){
+	unsigned long long bytes = (unsigned long long)megabytes << 20;
+	unsigned long long bucket_count = 1;
+	Transposition_Table_free(table);
+	if (bytes < sizeof(TT_Bucket)){
+		return true;
+	}
+	while (bucket_count * 2 * sizeof(TT_Bucket) <= bytes){
+		bucket_count *= 2;
+	}
+	table->buckets = table_alloc(bucket_count * sizeof(TT_Bucket));
+	if (!table->buckets){
+		return false;
+	}
+	table->bucket_mask = bucket_count - 1;
+	Transposition_Table_clear(table);
+	return true;
+}
+//  Start a new search so older entries are replaced first
+void Transposition_Table_new_search(Transposition_Table* table){
+	table->age = (table->age + 1) % TT_AGE_COUNT;
+}
+
+bool Transposition_Table_probe(Transposition_Table* table, unsigned long long key, TT_Hit* hit){
+	TT_Entry* entries;
+	unsigned long long check;
+	unsigned long long data;
+	int i;
+	if (!table->buckets){
+		return false;
+	}
+	entries = table->buckets[key & table->bucket_mask].entries;
+	for (i=0; i<TT_BUCKET_SIZE; ++i){
+		check = __atomic_load_n(&entries[i].check, __ATOMIC_RELAXED);
+		data = __atomic_load_n(&entries[i].data, __ATOMIC_RELAXED);
+		if ((check ^ data) == key && tt_bound(data) != TT_NO_BOUND){
+			hit->move = tt_move(data);
+			hit->score = tt_score(data);
+			hit->depth = tt_depth(data);
+			hit->bound = tt_bound(data);
+			return true;
+		}
+	}
+	return false;
+}
+
+//  Store a result. The position's own entry is updated in place unless it holds
+//   a deeper result from this search. Otherwise the entry replaced is the one with
+//   the least value, where value is depth minus how many searches ago it was stored
+void Transposition_Table_store(
+	Transposition_Table* table, unsigned long long key,
+	int depth, int bound, int score, Packed_Move move
+){
+	TT_Entry* entries;
+	TT_Entry* victim = NULL;
+	unsigned long long check;
+	unsigned long long data;
+	int value;
+	int victim_value = 0;
+	int i;
+	if (!table->buckets){
+		return;
+	}
+	entries = table->buckets[key & table->bucket_mask].entries;
+	for (i=0; i<TT_BUCKET_SIZE; ++i){
+		check = __atomic_load_n(&entries[i].check, __ATOMIC_RELAXED);
+		data = __atomic_load_n(&entries[i].data, __ATOMIC_RELAXED);
+		if ((check ^ data) == key && tt_bound(data) != TT_NO_BOUND){
+			if (tt_age(data) == table->age && tt_depth(data) > depth && bound != TT_EXACT){
+				return;
+			}
+			// Keep the known best move when the new result has none
+			move = move ? move:tt_move(data);
+			victim = &entries[i];
+			break;
+		}
+		value = (tt_bound(data) == TT_NO_BOUND) ? -(TT_AGE_COUNT*2) : (
+			tt_depth(data) - 2*((table->age - tt_age(data) + TT_AGE_COUNT) % TT_AGE_COUNT)
+		);
+		if (!victim || value < victim_value){
+			victim = &entries[i];
+			victim_value = value;
+		}
+	}
+	data = tt_pack(move, score, (depth < 0) ? 0:depth, bound, table->age);
+	__atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+}
+
+// Sliding-piece attack tables(magic bitboards)
+//  A slider's attack set only depends on the occupancy of the squares
+//  in its `mask`, so (occupied & mask) * magic >> shift maps every such
+//  occupancy to a precomputed entry of its square's slice of the table
+#define ROOK_ATTACK_TABLE_SIZE 102400
+#define BISHOP_ATTACK_TABLE_SIZE 5248
+
+typedef struct Magic{
+	bitboard mask;
+	bitboard magic;
+	bitboard* attacks;
+	int shift;
+} Magic;
+
+static const bitboard rook_magic_numbers[SQUARE_COUNT] = {
+	0x1080004008801020ULL,	0x0840092002C03000ULL,	0x1900200010400900ULL,	0x0880100008000480ULL,
+	0x4200100420080200ULL,	0x8100020100080400ULL,	0x0200040110886200ULL,	0x0200008040220411ULL,
+	0x0404800084400220ULL,	0x0000401000402000ULL,	0x0086001081220440ULL,	0x0408800800100280ULL,
+	0x000A001201040820ULL,	0x8848800200840080ULL,	0x4001000100040200ULL,	0x0442000102105084ULL,
+	0x9080010020804100ULL,	0x0040404000201009ULL,	0x0000808010002009ULL,	0x2200090021D00100ULL,
+	0x0008008008040080ULL,	0x0004004002010040ULL,	0x0011040008015042ULL,	0x00000A0001768104ULL,
+	0x0000800080204009ULL,	0x2010004140002001ULL,	0x9800200280100080ULL,	0x1000100080080080ULL,
+	0x0442000A00049020ULL,	0x2100040080020080ULL,	0x0800120400900148ULL,	0x0010040A00128541ULL,
+	0x2800804000800030ULL,	0x1010002000400041ULL,	0x4000200011004100ULL,	0x0610008410800800ULL,
+	0x0400802402800800ULL,	0xC100020080800400ULL,	0x0002000802000401ULL,	0x0182085882000401ULL,
+	0x0220204000808000ULL,	0x2860100040024022ULL,	0x0001002004110040ULL,	0x99101042000A0020ULL,
+	0x0004080004008080ULL,	0x0010040002008080ULL,	0x2012004881020004ULL,	0x8300842444820011ULL,
+	0x0088403882010200ULL,	0x0820400080210100ULL,	0x0110910040A00300ULL,	0x0801100280080480ULL,
+	0x0242009008200600ULL,	0x1002000489500200ULL,	0x0040800200010080ULL,	0x0091800041000080ULL,
+	0x0000209300488001ULL,	0x04C1002414824001ULL,	0x020020000B001041ULL,	0x7000100004200901ULL,
+	0x8002002004100802ULL,	0x30010002084C0007ULL,	0x0888221800813004ULL,	0x4000002840840112ULL
+};
+static const bitboard bishop_magic_numbers[SQUARE_COUNT] = {
+	0xA010041108003100ULL,	0x006082020A002900ULL,	0x6810010619200000ULL,	0x08281A0520000408ULL,
+	0x0001104001000400ULL,	0x0018901008048400ULL,	0x00040A0210245280ULL,	0x000200210808A402ULL,
+	0x9140048410821200ULL,	0x0800091010820041ULL,	0x20504804832202C0ULL,	0x0100091401081000ULL,
+	0x8021011140000012ULL,	0x0810020804450400ULL,	0x208B0542109008A2ULL,	0x0080084A08040204ULL,
+	0x0040E2A80811244CULL,	0x2505022008008108ULL,	0x0430220100420040ULL,	0x010A040420220040ULL,
+	0x1105000290400000ULL,	0x0093001200822120ULL,	0x4000A62048043004ULL,	0x280120048A015004ULL,
+	0x006090002A020814ULL,	0x44042000240800D0ULL,	0x01102800040A4400ULL,	0x1004080080220040ULL,
+	0x0001001011004024ULL,	0x0010044000805040ULL,	0x0914041200820100ULL,	0x0004821012821480ULL,
+	0x0024040500C05021ULL,	0x0088611002080200ULL,	0x0116080A00040020ULL,	0x4000020080080080ULL,
+	0x2450450140840040ULL,	0x0000880201484100ULL,	0x0222020404020092ULL,	0x8081110600002E00ULL,
+	0x2842101105000801ULL,	0x1100809008001025ULL,	0x00020202221C0400ULL,	0x0422014022009020ULL,
+	0x0210046102100C00ULL,	0xC004008082029102ULL,	0x00AA461801101200ULL,	0x0404080080201108ULL,
+	0x020542108C205002ULL,	0x0410544804100100ULL,	0x0040910841100000ULL,	0x0400200042021100ULL,
+	0x00004204850400C0ULL,	0x0200100410A42102ULL,	0x1040020801210102ULL,	0x0805040410420000ULL,
+	0x2884804130100200ULL,	0x800C262201242000ULL,	0x1058000194108800ULL,	0x0014221054420204ULL,
+	0x0104000012A02200ULL,	0x0200881003300100ULL,	0x0140400202840100ULL,	0x0402020801010201ULL
+};
+
+static bitboard rook_attack_table[ROOK_ATTACK_TABLE_SIZE];
+static bitboard bishop_attack_table[BISHOP_ATTACK_TABLE_SIZE];
+static Magic rook_magics[SQUARE_COUNT];
+static Magic bishop_magics[SQUARE_COUNT];
+static bool attack_tables_ready = false;
+
+//  Attacks along a set of 4 rays(the rook's or the bishop's).
+//   Only used to fill the tables
+bitboard slider_attacks_slow(int sq, bitboard occupied, int first_direction){
+	bitboard attacks = 0;
+	int d;
+	for (d=first_direction; d<first_direction+4; ++d){
+		attacks |= ray_attacks(sq, occupied, d);
+	}
+	return attacks;
+}
+
+//  Relevant occupancy squares: the rays minus the edge squares that end them
+bitboard slider_mask(int sq, int first_direction){
+	bitboard mask = 0;
+	int d;
+	for (d=first_direction; d<first_direction+4; ++d){
+		if (!is_rook_direction(d)){
+			mask |= ray_table[d][sq] & ~(TOP_ROW_BB | BOTTOM_ROW_BB | LEFT_COL_BB | RIGHT_COL_BB);
+		}else if (is_vertical_direction(d)){
+			mask |= ray_table[d][sq] & ~(TOP_ROW_BB | BOTTOM_ROW_BB);
+		}else{ // Horizontal rays
+			mask |= ray_table[d][sq] & ~(LEFT_COL_BB | RIGHT_COL_BB);
+		}
+	}
+	return mask;
+}
+
+void init_magics(Magic* magics, const bitboard* magic_numbers, bitboard* table, int first_direction){
+	int sq;
+	bitboard subset;
+	bitboard* attacks = table;
+	for (sq=0; sq<SQUARE_COUNT; ++sq){
+		magics[sq].mask = slider_mask(sq, first_direction);
+		magics[sq].magic = magic_numbers[sq];
+		magics[sq].shift = SQUARE_COUNT - bitboard_count(magics[sq].mask);
+		magics[sq].attacks = attacks;
+		// Fill in the attack set of every occupancy subset of the mask
+		subset = 0;
+		do{
+			attacks[(subset * magics[sq].magic) >> magics[sq].shift] = (
+				slider_attacks_slow(sq, subset, first_direction)
+			);
+			subset = (subset - magics[sq].mask) & magics[sq].mask;
+		}while (subset);
+		attacks += 1ULL << (SQUARE_COUNT - magics[sq].shift);
+	}
+}
+
+void init_attack_tables(void){
+	if (attack_tables_ready){
+		return;
+	}
+	init_magics(rook_magics, rook_magic_numbers, rook_attack_table, 0);
+	init_magics(bishop_magics, bishop_magic_numbers, bishop_attack_table, 4);
+	attack_tables_ready = true;
+}
+
+bitboard rook_attacks(int sq, bitboard occupied){
+	const Magic* m = &rook_magics[sq];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+bitboard bishop_attacks(int sq, bitboard occupied){
+	const Magic* m = &bishop_magics[sq];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+bitboard queen_attacks(int sq, bitboard occupied){
+	return rook_attacks(sq, occupied) | bishop_attacks(sq, occupied);
+}
+
 // Move functions
 //  An almost null Move that is default initialized, but
 //   makes everything as non-null as possible so a player can write over
@@ -327,6 +1032,11 @@ Move Move_init10(
 	return Move_init2(notation, gain);
 }
 
+//  Scored_Move functions
+Scored_Move Scored_Move_init0(void){
+	return (Scored_Move){NULL_PACKED_MOVE, NULL_GAIN};
+}
+
 //  Piece functions
 Piece Piece_init0(void){
 	return (Piece){NO_COLOR, NO_RANK};
@@ -348,33 +1058,290 @@ bool are_enemies(Piece p, Piece p2){
 		&& p.color != p2.color
 	);
 }
+int rank_index(char rank){
+	return piece_code(rank) - 1; // -1 for the null piece
+}
+
+//  Board mutation functions
+//   Every change to `board` goes through these so the bitboards
+//   and attack maps stay in sync
+//    The squares attacked by the occupant of a square
+bitboard Chess_Game_square_attacks(Chess_Game* game, int sq){
+	Piece p = game->board[square_row(sq)][square_col(sq)];
+	switch (p.rank){
+		case KING: return king_attack_table[sq];
+		case QUEEN: return queen_attacks(sq, game->occupied);
+		case BISHOP: return bishop_attacks(sq, game->occupied);
+		case KNIGHT: return knight_attack_table[sq];
+		case ROOK: return rook_attacks(sq, game->occupied);
+		case PAWN: return pawn_attack_table[color_index(p.color)][sq];
+		default: return 0;
+	}
+}
+
+//    Add a square to or remove it from its occupant's piece list
+void Chess_Game_list_piece(Chess_Game* game, int sq, int color){
+	game->piece_list_indices[sq] = game->piece_counts[color];
+	game->piece_lists[color][game->piece_counts[color]++] = sq;
+}
+void Chess_Game_unlist_piece(Chess_Game* game, int sq, int color){
+	// Move the last entry into the freed slot
+	int last = game->piece_lists[color][--game->piece_counts[color]];
+	game->piece_lists[color][game->piece_list_indices[sq]] = last;
+	game->piece_list_indices[last] = game->piece_list_indices[sq];
+}
+
+//    Add(sign = 1) or remove(sign = -1) the occupant's attacks from its color's map
+void Chess_Game_count_attacks(Chess_Game* game, int sq, int sign){
+	int color = color_index(game->board[square_row(sq)][square_col(sq)].color);
+	bitboard attacks = game->piece_attacks[sq];
+	int target;
+	while (attacks){
+		target = bitboard_lsb(attacks);
+		attacks &= attacks - 1;
+		game->attacker_counts[color][target] += sign;
+		if (game->attacker_counts[color][target]){
+			game->attack_maps[color] |= square_bb(target);
+		}else{
+			game->attack_maps[color] &= ~square_bb(target);
+		}
+	}
+}
+
+void Chess_Game_set_piece(Chess_Game* game, int row, int col, Piece p){
+	int sq = square_index(row, col);
+	Piece old = game->board[row][col];
+	bitboard sliders;
+	int slider;
+	
+	// Remove the previous occupant from the bitboards and attack maps
+	if (is_valid_color(old.color)){
+		Chess_Game_count_attacks(game, sq, -1);
+		game->piece_attacks[sq] = 0;
+		Chess_Game_unlist_piece(game, sq, color_index(old.color));
+		game->color_bbs[color_index(old.color)] &= ~square_bb(sq);
+		game->rank_bbs[rank_index(old.rank)] &= ~square_bb(sq);
+		game->occupied &= ~square_bb(sq);
+		game->key ^= zobrist_piece_keys[color_index(old.color)][rank_index(old.rank)][sq];
+		if (old.rank == PAWN){
+			game->pawn_key ^= zobrist_piece_keys[color_index(old.color)][PAWN_INDEX][sq];
+		}
+		game->midgame_score -= piece_square_scores[MIDGAME][color_index(old.color)][rank_index(old.rank)][sq];
+		game->endgame_score -= piece_square_scores[ENDGAME][color_index(old.color)][rank_index(old.rank)][sq];
+		game->phase -= phase_weights[rank_index(old.rank)];
+	}
+	// Add the new occupant
+	if (is_valid_color(p.color)){
+		Chess_Game_list_piece(game, sq, color_index(p.color));
+		game->color_bbs[color_index(p.color)] |= square_bb(sq);
+		game->rank_bbs[rank_index(p.rank)] |= square_bb(sq);
+		game->occupied |= square_bb(sq);
+		game->key ^= zobrist_piece_keys[color_index(p.color)][rank_index(p.rank)][sq];
+		if (p.rank == PAWN){
+			game->pawn_key ^= zobrist_piece_keys[color_index(p.color)][PAWN_INDEX][sq];
+		}
+		game->midgame_score += piece_square_scores[MIDGAME][color_index(p.color)][rank_index(p.rank)][sq];
+		game->endgame_score += piece_square_scores[ENDGAME][color_index(p.color)][rank_index(p.rank)][sq];
+		game->phase += phase_weights[rank_index(p.rank)];
+	}
+	game->board[row][col] = p;
+	if (is_valid_color(p.color)){
+		game->piece_attacks[sq] = Chess_Game_square_attacks(game, sq);
+		Chess_Game_count_attacks(game, sq, 1);
+	}
+	
+	// The only other attacks that change are those of the sliders 
+	//  whose rays reach this square
+	if (is_valid_color(old.color) == is_valid_color(p.color)){
+		return; // Occupancy is unchanged so every ray is too
+	}
+	sliders = (
+		(rook_attacks(sq, game->occupied) 
+		 & (game->rank_bbs[ROOK_INDEX] | game->rank_bbs[QUEEN_INDEX]))
+		| (bishop_attacks(sq, game->occupied) 
+		   & (game->rank_bbs[BISHOP_INDEX] | game->rank_bbs[QUEEN_INDEX]))
+	);
+	while (sliders){
+		slider = bitboard_lsb(sliders);
+		sliders &= sliders - 1;
+		Chess_Game_count_attacks(game, slider, -1);
+		game->piece_attacks[slider] = Chess_Game_square_attacks(game, slider);
+		Chess_Game_count_attacks(game, slider, 1);
+	}
+}
+
+//    Rebuild the bitboards, attack maps, piece lists and scores from `board` from scratch
+void Chess_Game_refresh_bitboards(Chess_Game* game){
+	int i, j;
+	int sq;
+	int ci, ri;
+	game->color_bbs[WHITE_INDEX] = game->color_bbs[BLACK_INDEX] = 0;
+	for (i=0; i<RANK_COUNT; ++i){
+		game->rank_bbs[i] = 0;
+	}
+	game->occupied = 0;
+	game->key = (game->side_to_move == BLACK) ? zobrist_side_key:0;
+	game->pawn_key = 0;
+	game->piece_counts[WHITE_INDEX] = game->piece_counts[BLACK_INDEX] = 0;
+	game->midgame_score = game->endgame_score = game->phase = 0;
+	for (i=0; i<BOARD_SIZE; ++i){
+		for (j=0; j<BOARD_SIZE; ++j){
+			if (!is_valid_color(game->board[i][j].color)){
+				continue;
+			}
+			Chess_Game_list_piece(game, square_index(i, j), color_index(game->board[i][j].color));
+			game->color_bbs[color_index(game->board[i][j].color)] |= square_bb(square_index(i, j));
+			game->rank_bbs[rank_index(game->board[i][j].rank)] |= square_bb(square_index(i, j));
+			game->occupied |= square_bb(square_index(i, j));
+			game->key ^= zobrist_piece_keys[color_index(game->board[i][j].color)]
+										   [rank_index(game->board[i][j].rank)][square_index(i, j)];
+			ci = color_index(game->board[i][j].color);
+			ri = rank_index(game->board[i][j].rank);
+			if (ri == PAWN_INDEX){
+				game->pawn_key ^= zobrist_piece_keys[ci][PAWN_INDEX][square_index(i, j)];
+			}
+			game->midgame_score += piece_square_scores[MIDGAME][ci][ri][square_index(i, j)];
+			game->endgame_score += piece_square_scores[ENDGAME][ci][ri][square_index(i, j)];
+			game->phase += phase_weights[ri];
+		}
+	}
+	game->attack_maps[WHITE_INDEX] = game->attack_maps[BLACK_INDEX] = 0;
+	for (sq=0; sq<SQUARE_COUNT; ++sq){
+		game->attacker_counts[WHITE_INDEX][sq] = game->attacker_counts[BLACK_INDEX][sq] = 0;
+	}
+	for (sq=0; sq<SQUARE_COUNT; ++sq){
+		game->piece_attacks[sq] = Chess_Game_square_attacks(game, sq);
+		if (game->piece_attacks[sq]){
+			Chess_Game_count_attacks(game, sq, 1);
+		}
+	}
+}
+
+//   Set the color to move next
+void Chess_Game_set_side_to_move(Chess_Game* game, char color){
+	if (game->side_to_move != color){
+		game->side_to_move = color;
+		game->key ^= zobrist_side_key;
+	}
+}
+
+//   Make a move(assumed to follow the movement rules) so that it can later
+//    be unmade. Returns false without making it when the undo stack is full
+bool Chess_Game_make_move(Chess_Game* game, Packed_Move pm){
+	int from = packed_move_from(pm);
+	int to = packed_move_to(pm);
+	Undo_Record* record;
+	int* king_loc;
+	if (game->undo_count == UNDO_STACK_SIZE){
+		return false;
+	}
+	
+	// Save everything the move can change
+	record = &game->undo_stack[game->undo_count++];
+	record->move = pm;
+	record->last_move = game->last_move;
+	record->mover = game->board[square_row(from)][square_col(from)];
+	record->captured = game->board[square_row(to)][square_col(to)];
+	record->check = game->check;
+	record->checked_color = game->checked_color;
+	record->checkmate = game->checkmate;
+	record->checkmated_color = game->checkmated_color;
+	record->side_to_move = game->side_to_move;
+	record->king_locs[0][0] = game->cpu_king_loc[0];
+	record->king_locs[0][1] = game->cpu_king_loc[1];
+	record->king_locs[1][0] = game->player_king_loc[0];
+	record->king_locs[1][1] = game->player_king_loc[1];
+	
+	// Move the piece, capturing and promoting as needed.
+	//  The origin is vacated first so the mover is never listed twice
+	Chess_Game_set_piece(game, square_row(from), square_col(from), Piece_init0());
+	Chess_Game_set_piece(
+		game, square_row(to), square_col(to), 
+		packed_move_promotion(pm) 
+		? Piece_init2(record->mover.color, rank_labels[packed_move_promotion(pm)])
+		: record->mover
+	);
+	
+	// Track the king
+	if (record->mover.rank == KING){
+		king_loc = (record->mover.color == game->player_color) 
+				   ? game->player_king_loc:game->cpu_king_loc;
+		king_loc[0] = square_row(to);
+		king_loc[1] = square_col(to);
+	}
+	// Pass the move to the other color
+	Chess_Game_set_side_to_move(game, other_color(record->mover.color));
+	game->last_move = pm;
+	return true;
+}
+
+//   Unmake the most recently made move
+void Chess_Game_unmake_move(Chess_Game* game){
+	Undo_Record* record = &game->undo_stack[--game->undo_count];
+	int from = packed_move_from(record->move);
+	int to = packed_move_to(record->move);
+	
+	// Restore the captured piece before the mover so no color is ever overfull
+	Chess_Game_set_piece(game, square_row(to), square_col(to), record->captured);
+	Chess_Game_set_piece(game, square_row(from), square_col(from), record->mover);
+	
+	game->last_move = record->last_move;
+	game->check = record->check;
+	game->checked_color = record->checked_color;
+	game->checkmate = record->checkmate;
+	game->checkmated_color = record->checkmated_color;
+	Chess_Game_set_side_to_move(game, record->side_to_move);
+	game->cpu_king_loc[0] = record->king_locs[0][0];
+	game->cpu_king_loc[1] = record->king_locs[0][1];
+	game->player_king_loc[0] = record->king_locs[1][0];
+	game->player_king_loc[1] = record->king_locs[1][1];
+}
+
+//   Attack queries
+//    The pieces of a color attacking a square given some board occupancy
+bitboard Chess_Game_attackers_to(Chess_Game* game, int sq, bitboard occupied, char by_color){
+	int ci = color_index(by_color);
+	bitboard queens = game->rank_bbs[QUEEN_INDEX];
+	return game->color_bbs[ci] & (
+		(pawn_attack_table[!ci][sq] & game->rank_bbs[PAWN_INDEX])
+		| (knight_attack_table[sq] & game->rank_bbs[KNIGHT_INDEX])
+		| (king_attack_table[sq] & game->rank_bbs[KING_INDEX])
+		| (bishop_attacks(sq, occupied) & (game->rank_bbs[BISHOP_INDEX] | queens))
+		| (rook_attacks(sq, occupied) & (game->rank_bbs[ROOK_INDEX] | queens))
+	);
+}
+bool Chess_Game_is_attacked(Chess_Game* game, int sq, char by_color){
+	return (game->attack_maps[color_index(by_color)] & square_bb(sq)) != 0;
+}
 
 //  Piece_Attributes functions
 //   Forward declarations
 //    King function(s)
 bool king_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool king_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move king_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move king_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
 //    Queen function(s)
 bool queen_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool queen_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move queen_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move queen_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
 //    Bishop function(s)
 bool bishop_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool bishop_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move bishop_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move bishop_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
 //    Knight function(s)
 bool knight_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool knight_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move knight_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move knight_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
 //    Rook function(s)
 bool rook_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool rook_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move rook_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move rook_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
 //    Pawn function(s)
 bool pawn_can_move(Chess_Game* game, int row, int col, int row2, int col2);
 bool pawn_can_capture(Chess_Game* game, int row, int col, int row2, int col2);
-Move pawn_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+Scored_Move pawn_optimal_move(Chess_Game* game, int row, int col, byte loss_class);
+//    Shared by every piece's optimal_move
+Scored_Move piece_optimal_move(Chess_Game* game, int row, int col, bitboard targets, byte loss_class);
 
 //   Constructors
 Piece_Attributes Piece_Attributes_init0(void){
@@ -383,53 +1350,47 @@ Piece_Attributes Piece_Attributes_init0(void){
 		NULL, NULL, NULL
 	};
 }
+//    One entry per piece code
+static const Piece_Attributes piece_attributes_table[PIECE_CODE_COUNT] = {
+	{0, NULL, NULL, NULL}, // null piece(no rank)
+	{KING_VALUE, king_can_move, king_can_capture, king_optimal_move},
+	{QUEEN_VALUE, queen_can_move, queen_can_capture, queen_optimal_move},
+	{BISHOP_VALUE, bishop_can_move, bishop_can_capture, bishop_optimal_move},
+	{KNIGHT_VALUE, knight_can_move, knight_can_capture, knight_optimal_move},
+	{ROOK_VALUE, rook_can_move, rook_can_capture, rook_optimal_move},
+	{PAWN_VALUE, pawn_can_move, pawn_can_capture, pawn_optimal_move}
+};
+#define piece_value(rank) (piece_attributes_table[piece_code(rank)].piece_value)
 Piece_Attributes Piece_Attributes_init1(char rank){
-	Piece_Attributes pa;
-	switch (rank){
-		case KING:
-			pa.piece_value = KING_VALUE;
-			pa.optimal_move = king_optimal_move;
-			pa.can_capture = king_can_capture;
-			pa.can_move = king_can_move;
-			break;
-		case QUEEN:
-			pa.piece_value = QUEEN_VALUE;
-			pa.optimal_move = queen_optimal_move;
-			pa.can_capture = queen_can_capture;
-			pa.can_move = queen_can_move;
-			break;
-		case BISHOP:
-			pa.piece_value = BISHOP_VALUE;
-			pa.optimal_move = bishop_optimal_move;
-			pa.can_capture = bishop_can_capture;
-			pa.can_move = bishop_can_move;
-			break;
-		case KNIGHT:
-			pa.piece_value = KNIGHT_VALUE;
-			pa.optimal_move = knight_optimal_move;
-			pa.can_capture = knight_can_capture;
-			pa.can_move = knight_can_move;
-			break;
-		case ROOK:
-			pa.piece_value = ROOK_VALUE;
-			pa.optimal_move = rook_optimal_move;
-			pa.can_capture = rook_can_capture;
-			pa.can_move = rook_can_move;
-			break;
-		case PAWN:
-			pa.piece_value = PAWN_VALUE;
-			pa.optimal_move = pawn_optimal_move;
-			pa.can_capture = pawn_can_capture;
-			pa.can_move = pawn_can_move;
-			break;
-		default: // null piece(no rank)
-			pa = Piece_Attributes_init0();
-			break;
-	}
-	return pa;
+	return piece_attributes_table[piece_code(rank)];
 }
 
 //   Helpers
+bitboard pawn_push_targets(Chess_Game* game, int row, int col){
+	// Pawns step 1 or 2 squares forward onto empty squares
+	bitboard single_step;
+	if (game->board[row][col].color == WHITE){
+		single_step = (square_bb(square_index(row, col)) >> BOARD_SIZE) & ~game->occupied;
+		return single_step | ((single_step >> BOARD_SIZE) & ~game->occupied);
+	}
+	single_step = (square_bb(square_index(row, col)) << BOARD_SIZE) & ~game->occupied;
+	return single_step | ((single_step << BOARD_SIZE) & ~game->occupied);
+}
+
+//    The squares the occupant of a square can move to. Pawns push forward 
+//    and only move diagonally to capture; every other piece moves to the 
+//    squares it attacks that aren't held by allies
+bitboard Chess_Game_piece_targets(Chess_Game* game, int sq){
+	int ci = color_index(game->board[square_row(sq)][square_col(sq)].color);
+	if (game->rank_bbs[PAWN_INDEX] & square_bb(sq)){
+		return (
+			pawn_push_targets(game, square_row(sq), square_col(sq))
+			| (game->piece_attacks[sq] & game->color_bbs[!ci])
+		);
+	}
+	return game->piece_attacks[sq] & ~game->color_bbs[ci];
+}
+
 bool can_promote(Chess_Game* game, int row, int col, int row2, int col2){
 	bool invalid_params = (
 		!is_valid_rown(row) || !is_valid_coln(col)
@@ -446,111 +1407,130 @@ bool can_promote(Chess_Game* game, int row, int col, int row2, int col2){
 }
 
 bool can_capture(Chess_Game* game, int row, int col){
-	int i, j;
-	Piece_Attributes pa;
-	for (i=0; i<BOARD_SIZE; ++i){
-		for(j=0; j<BOARD_SIZE; ++j){
-			// Skip non-enemies
-			if (!are_enemies(game->board[i][j], game->board[row][col])){
-				continue;
-			}
-			// Check if the piece is capturable
-			pa = Piece_Attributes_init1(game->board[i][j].rank);
-			if (pa.can_capture(game, i, j, row, col)){
-				return true;
-			}
+	// Empty squares have no enemies
+	if (!is_valid_color(game->board[row][col].color)){
+		return false;
+	}
+	// Look the square up in the enemy attack map
+	return Chess_Game_is_attacked(
+		game, square_index(row, col), 
+		other_color(game->board[row][col].color)
+	);
+}
+
+//    Ranks from least to most valuable, the order pieces join an exchange in
+static const int exchange_order[RANK_COUNT] = {
+	PAWN_INDEX, KNIGHT_INDEX, BISHOP_INDEX, ROOK_INDEX, QUEEN_INDEX, KING_INDEX
+};
+
+//    Static exchange evaluation: the material the mover nets when both sides keep
+//     recapturing on the move's destination with their least valuable attacker,
+//     each stopping once recapturing would lose more.
+//     Pieces behind a capturer join once it leaves its square, but pins and
+//     promotions after the first move are ignored
+int Chess_Game_see(Chess_Game* game, Packed_Move pm){
+	int gains[2*MAX_PIECES + 1];
+	int depth = 0;
+	int from = packed_move_from(pm);
+	int to = packed_move_to(pm);
+	int promotion = packed_move_promotion(pm);
+	char color = game->board[square_row(from)][square_col(from)].color;
+	int attacker_value = promotion 
+						 ? piece_value(rank_labels[promotion])
+						 : piece_value(game->board[square_row(from)][square_col(from)].rank);
+	bitboard occupied = game->occupied;
+	bitboard attackers;
+	int i;
+	
+	gains[0] = piece_value(game->board[square_row(to)][square_col(to)].rank)
+			   + (promotion ? attacker_value - PAWN_VALUE:0);
+	while (depth < 2*MAX_PIECES){
+		// The last capturer now stands on the square and is what the next one takes
+		occupied ^= square_bb(from);
+		color = other_color(color);
+		++depth;
+		gains[depth] = attacker_value - gains[depth - 1];
+		// Find the side to capture's least valuable attacker
+		attackers = Chess_Game_attackers_to(game, to, occupied, color) & occupied;
+		if (!attackers){
+			break;
 		}
+		for (i=0; !(attackers & game->rank_bbs[exchange_order[i]]); ++i);
+		from = bitboard_lsb(attackers & game->rank_bbs[exchange_order[i]]);
+		attacker_value = piece_value(rank_labels[exchange_order[i]]);
 	}
-	return false;
+	// Either side may stop capturing, so settle the sequence from its end
+	while (--depth){
+		gains[depth - 1] = (-gains[depth - 1] < gains[depth]) ? -gains[depth]:gains[depth - 1];
+	}
+	return gains[0];
 }
 
 int calc_loss(Chess_Game* game, char target_color){
 	int enemy_gain = 0;
-	int i, j;
+	int i;
+	int sq;
 	int curr_gain;
-	Piece_Attributes pa;
-	for (i=0; i<BOARD_SIZE && enemy_gain < MAX_GAIN; ++i){
-		for (j=0; j<BOARD_SIZE && enemy_gain < MAX_GAIN; ++j){
-			// Skip null or ally pieces
-			if (game->board[i][j].color == NO_COLOR
-				|| game->board[i][j].color == target_color)
-			{
-				continue;
-			}
-			// Calculate the most optimal enemy Move's gain
-			pa = Piece_Attributes_init1(game->board[i][j].rank);
-			curr_gain = pa.optimal_move(game, i, j, NO_LOSS).gain;
-			enemy_gain = (enemy_gain < curr_gain) ? curr_gain:enemy_gain;
-		}
-	} 
+	// Only visit the enemy pieces
+	int enemy = color_index(other_color(target_color));
+	for (i=0; i<game->piece_counts[enemy] && enemy_gain < MAX_GAIN; ++i){
+		sq = game->piece_lists[enemy][i];
+		// Calculate the most optimal enemy Move's gain
+		curr_gain = piece_optimal_move(
+			game, square_row(sq), square_col(sq), 
+			Chess_Game_piece_targets(game, sq), NO_LOSS
+		).gain;
+		enemy_gain = (enemy_gain < curr_gain) ? curr_gain:enemy_gain;
+	}
 	return enemy_gain;
 }
 
-Move piece_optimal_move(
+Scored_Move piece_optimal_move(
 	Chess_Game* game, int row, int col,
-	int max_pos_offsets, int (*pos_offsets)[2], byte loss_class
+	bitboard targets, byte loss_class
 ){
 	// Consider total gain(potential gains minus potential losses) from 
 	//  moving to a certain position
 	//  Gain primarily comes from captures and special cases like promotion.
 	//  Loss is simply total enemy gain
-	//  The maximum gain wil be used to decide values
-	//  for variables that will be used to construct an optimal Move object
-
-	//  Setup of Move object builders/variables
-	int optimal_offsets[2] = {0, 0};
-	int max_gain = NULL_GAIN;
-	//   Always-applicable variables
-	bool capture = false;
-	//   Special case variables
-	bool promoted = false;
-	char promoted_rank = NO_RANK;
+	//  The move with the maximum gain is returned
+
+	//  Setup of the optimal move
+	Scored_Move optimal = Scored_Move_init0();
 	//   Game terminating variables
 	bool won = false;
 	
-	// Iterate over positional/capture offsets
-	//  to find the optimal values for the Move object builders 
-	//  by considering the total gain from every new position. Stop
-	//  when the max gain is found(meaning we found a checkmate-creating move)
-	int row2, col2;
-	Piece self;
-	Piece captured;
-	Piece promoted_piece;
-	
-	Piece_Attributes pa = (
-		Piece_Attributes_init1(game->board[row][col].rank)
-	);
-	Piece_Attributes pa2;
+	// Iterate over the squares the piece can move to
+	//  to find the optimal move by considering 
+	//  the total gain from every new position
+	int value = piece_value(game->board[row][col].rank);
+	int captured_value;
 	int loss;
-	int i;
+	int sq;
 	int gain;
 	bool promotion;
+	int target_count = bitboard_count(targets);
 	
-	for (i=0; i<max_pos_offsets; ++i){
-		int curr_r = row + pos_offsets[i][0];
-		int curr_c = col + pos_offsets[i][1];
-		
-		// Ensure that the piece can move there
-		if (!pa.can_move(game, row, col, curr_r, curr_c)){
-			continue;
-		}
+	while (targets){
+		sq = bitboard_lsb(targets);
+		targets &= targets - 1;
+		int curr_r = square_row(sq);
+		int curr_c = square_col(sq);
 		gain = 0;
 		// Find and handle gain at this capture position
-		pa2 = (
-			Piece_Attributes_init1(game->board[curr_r][curr_c].rank)
-		);
+		captured_value = piece_value(game->board[curr_r][curr_c].rank);
 		promotion = false;
 		
 		// Check for and handle terminal non-losing cases like a king's capture
 		won = (
 			are_enemies(game->board[row][col], game->board[curr_r][curr_c]) 
-			&& pa2.piece_value == KING_VALUE
+			&& captured_value == KING_VALUE
 		);
 		if (won){
 			gain = MAX_GAIN;
 		}else{ // Look for gain in other forms
 			// Check gain from captures
-			gain += pa2.piece_value;
+			gain += captured_value;
 			// Special cases
 			//  Check for gain from promotions
 			if ((promotion = can_promote(game,row, col, curr_r, curr_c))){
@@ -559,123 +1539,88 @@ Move piece_optimal_move(
 			// Check for loss/enemy gain
 			if (loss_class != NO_LOSS){
 				// Temporarily enact the move
-				Piece orig_at_origin = game->board[row][col];
-				Piece orig_at_dest = game->board[curr_r][curr_c];
-				game->board[row][col] = Piece_init0();
-				game->board[curr_r][curr_c] = orig_at_origin;
+				if (!Chess_Game_make_move(
+						game, 
+						pack_move(
+							square_index(row, col), sq, 
+							promotion ? QUEEN_INDEX:0, 
+							is_valid_color(game->board[curr_r][curr_c].color)
+						)
+					))
+				{
+					continue;
+				}
 				loss = 0;
 				// Calculate loss/enemy gain
 				if (loss_class == SELF_LOSS){ // Only calculate loss from this piece being captured
-					loss = can_capture(game, curr_r, curr_c) ? pa.piece_value:0;
+					loss = can_capture(game, curr_r, curr_c) ? value:0;
 				}else{ // Calculate maximum loss considering the full game state
-					loss = calc_loss(game, orig_at_origin.color);
+					loss = calc_loss(game, game->board[curr_r][curr_c].color);
 				}
-				if (loss == MAX_GAIN){ // We can undo and skip because this move is invalid
-					game->board[curr_r][curr_c] = orig_at_dest;
-					game->board[row][col] = orig_at_origin;
+
+				// Undo the move
+				Chess_Game_unmake_move(game);
+				
+				if (loss == MAX_GAIN){ // Skip because this move is invalid
 					continue; 
 				}else{
 					gain -= loss;
 				}
-
-				// Undo the move
-				game->board[curr_r][curr_c] = orig_at_dest;
-				game->board[row][col] = orig_at_origin;
 			}
 		}
 		
 		// Reassign Move variables if the gain is the new max
 		//  or somewhat randomly if it is equal to the max
-		if (gain > max_gain || (gain == max_gain && rand() % max_pos_offsets + 1 == 1)){
-			max_gain = gain;
-			optimal_offsets[0] = pos_offsets[i][0];
-			optimal_offsets[1] = pos_offsets[i][1];
-			capture = are_enemies(game->board[row][col], game->board[curr_r][curr_c]);
-			promoted = promotion;
-			promoted_rank = promotion ? QUEEN:NO_RANK;
+		if (gain > optimal.gain
+			|| (gain == optimal.gain
+				&& (unsigned int)random_next(&game->rng_state) % target_count == 0))
+		{
+			optimal.gain = gain;
+			optimal.move = pack_move(
+				square_index(row, col), sq, 
+				promotion ? QUEEN_INDEX:0, // Always promote to queen
+				are_enemies(game->board[row][col], game->board[curr_r][curr_c])
+			);
 		}
 	}
 	
-	// Build and return the optimal move
-	row2 = row + optimal_offsets[0];
-	col2 = col + optimal_offsets[1];
-	self = game->board[row][col];
-	captured = capture ? game->board[row2][col2]:Piece_init0();
-	promoted_piece = promoted
-					 ? Piece_init2(self.color, promoted_rank):Piece_init0();
-	return Move_init10(
-		self, row, col, row2, col2, 
-		capture, captured, 
-		promoted, promoted_piece, 
-		max_gain
-	);
+	return optimal;
 }
 
-bool correct_direction(int forward, int row, int row2){
-	return ((row2 - row)/forward >= 0);
+//   King function(s)
+bool king_can_move(Chess_Game* game, int row, int col, int row2, int col2){
+	bool invalid_params = (
+		!is_valid_rown(row) 
+		|| !is_valid_coln(col)
+		|| !is_valid_rown(row2) 
+		|| !is_valid_coln(col2)
+	);
+	return (
+		!invalid_params
+		&& (game->board[row2][col2].color != game->board[row][col].color)
+		&& (king_attack_table[square_index(row, col)] & square_bb(square_index(row2, col2)))
+	);
+}
+bool king_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
+	return king_can_move(game, row, col, row2, col2);
 }
 
-bool vertical_obstructed(Chess_Game* game, int row, int col, int row2, int col2){
-	int r_inc;
-	if (!is_valid_rown(row) || !is_valid_coln(col)
-		|| !is_valid_rown(row2) || !is_valid_coln(col2)
-		|| row == row2
-		|| col != col2)
-	{
-		return true;
-	}
-	r_inc = (row < row2) ? 1:-1;
-	for (row+=r_inc; row!=row2; row+=r_inc){
-		if (game->board[row][col].color != NO_COLOR){
-			return true;
-		}
+Scored_Move king_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
+	// Return a null move upon invalid parameters
+	if (!is_valid_rown(row) || !is_valid_coln(col)){
+		return Scored_Move_init0();
 	}
-	return false;
+	
+	// Return an optimal move among the attacked squares not held by allies
+	return piece_optimal_move(
+		game, row, col,
+		king_attack_table[square_index(row, col)]
+		& ~game->color_bbs[color_index(game->board[row][col].color)], 
+		loss_class
+	);
 }
-bool horizontal_obstructed(Chess_Game* game, int row, int col, int row2, int col2){
-	int c_inc;
-	if (!is_valid_rown(row) || !is_valid_coln(col)
-		|| !is_valid_rown(row2) || !is_valid_coln(col2)
-		|| col == col2
-		|| row != row2)
-	{
-		return true;
-	}
-	c_inc = (col < col2) ? 1:-1;
-	for (col+=c_inc; col!=col2; col+=c_inc){
-		if (game->board[row][col].color != NO_COLOR){
-			return true;
-		}
-	}
-	return false;
-}
-bool diagonal_obstructed(Chess_Game* game, int row, int col, int row2, int col2){
-	int r_inc;
-	int c_inc;
-	if (!is_valid_rown(row) || !is_valid_coln(col)
-		|| !is_valid_rown(row2) || !is_valid_coln(col2)
-		|| row == row2
-		|| col == col2
-		|| ((row2 - row)*(row2 - row) != (col2 - col)*(col2 - col))
-		)
-	{
-		return true;
-	}
-	r_inc = (row < row2) ? 1:-1; 
-	c_inc = (col < col2) ? 1:-1;
-	row += r_inc;
-	col += c_inc;
-	for (; row!=row2; row+=r_inc){
-		if (game->board[row][col].color != NO_COLOR){
-			return true;
-		}
-		col += c_inc;
-	}
-	return false;
-}
-
-//   King function(s)
-bool king_can_move(Chess_Game* game, int row, int col, int row2, int col2){
+//   Queen function(s)
+bool queen_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 	bool invalid_params = (
 		!is_valid_rown(row) 
 		|| !is_valid_coln(col)
@@ -685,61 +1630,26 @@ bool king_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 	return (
 		!invalid_params
 		&& (game->board[row2][col2].color != game->board[row][col].color)
-		&& ((row2 - row)*(row2 - row) <= 1)
-		&& ((col2 - col)*(col2 - col) <= 1)
-	);
-}
-bool king_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
-	return king_can_move(game, row, col, row2, col2);
-}
-
-Move king_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	int max_pos_offsets;
-	int pos_offsets[8][2] = {
-		{1,-1}, {1,0}, {1,1},
-		{0,-1}, {0,1}, 
-		{-1,-1}, {-1,0}, {-1,1}
-	};
-	
-	// Return a null move upon invalid parameters
-	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
-	}
-	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	max_pos_offsets = 8; 
-	return piece_optimal_move(
-		game, row, col,
-		max_pos_offsets, pos_offsets, loss_class
-	);
-}
-//   Queen function(s)
-bool queen_can_move(Chess_Game* game, int row, int col, int row2, int col2){
-	return (
-		bishop_can_move(game, row, col, row2, col2)
-		|| rook_can_move(game, row, col, row2, col2)
+		&& (queen_attacks(square_index(row, col), game->occupied) 
+			& square_bb(square_index(row2, col2)))
 	);
 }
 bool queen_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
 	return queen_can_move(game, row, col, row2, col2);
 }
 
-Move queen_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	Move bishop_opt_move;
-	Move rook_opt_move;
+Scored_Move queen_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
 	// Return a null move upon invalid parameters
 	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
+		return Scored_Move_init0();
 	}
 	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	bishop_opt_move = bishop_optimal_move(game, row, col, loss_class);
-	rook_opt_move = rook_optimal_move(game, row, col, loss_class);
-	return (
-		bishop_opt_move.gain > rook_opt_move.gain
-		? bishop_opt_move:rook_opt_move
+	// Return an optimal move among the attacked squares not held by allies
+	return piece_optimal_move(
+		game, row, col,
+		queen_attacks(square_index(row, col), game->occupied)
+		& ~game->color_bbs[color_index(game->board[row][col].color)], 
+		loss_class
 	);
 }
 //   Bishop function(s)
@@ -753,53 +1663,26 @@ bool bishop_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 	return (
 		!invalid_params
 		&& (game->board[row2][col2].color != game->board[row][col].color)
-		&& !diagonal_obstructed(game, row, col, row2, col2)
+		&& (bishop_attacks(square_index(row, col), game->occupied) 
+			& square_bb(square_index(row2, col2)))
 	);
 }
 bool bishop_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
 	return bishop_can_move(game, row, col, row2, col2);
 }
 
-Move bishop_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	int max_pos_offsets;
-	int pos_offsets[32][2];
-	int i, j;
-	
+Scored_Move bishop_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
 	// Return a null move upon invalid parameters
 	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
+		return Scored_Move_init0();
 	}
 	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	max_pos_offsets = 32;
-	{
-		i = 0; 
-		j = 0;
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = i + 1;
-			pos_offsets[j][1] = i + 1;
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = i + 1;
-			pos_offsets[j][1] = -(i + 1);
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = -(i + 1);
-			pos_offsets[j][1] = -(i + 1);
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = -(i + 1);
-			pos_offsets[j][1] = i + 1;
-			++j;
-		}
-	} 
+	// Return an optimal move among the attacked squares not held by allies
 	return piece_optimal_move(
 		game, row, col,
-		max_pos_offsets, pos_offsets, loss_class
+		bishop_attacks(square_index(row, col), game->occupied)
+		& ~game->color_bbs[color_index(game->board[row][col].color)], 
+		loss_class
 	);
 }
 //   Knight function(s)
@@ -813,34 +1696,25 @@ bool knight_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 	return (
 		!invalid_params
 		&& (game->board[row2][col2].color != game->board[row][col].color)
-		&& (
-			((row2 - row)*(row2 - row) == 4 && (col2 - col)*(col2 - col) == 1)
-			|| ((row2 - row)*(row2 - row) == 1 && (col2 - col)*(col2 - col) == 4)
-		)
+		&& (knight_attack_table[square_index(row, col)] & square_bb(square_index(row2, col2)))
 	);
 }
 bool knight_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
 	return knight_can_move(game, row, col, row2, col2);
 }
 
-Move knight_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	int max_pos_offsets;
-	int pos_offsets[8][2] = {
-		{2,-1}, {2,1}, {-2,-1}, {-2,1},
-		{1,-2}, {1,2}, {-1,-2}, {-1,2}
-	};
-	
+Scored_Move knight_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
 	// Return a null move upon invalid parameters
 	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
+		return Scored_Move_init0();
 	}
 	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	max_pos_offsets = 8;
+	// Return an optimal move among the attacked squares not held by allies
 	return piece_optimal_move(
 		game, row, col,
-		max_pos_offsets, pos_offsets, loss_class
+		knight_attack_table[square_index(row, col)]
+		& ~game->color_bbs[color_index(game->board[row][col].color)], 
+		loss_class
 	);
 }
 //   Rook function(s)
@@ -851,60 +1725,29 @@ bool rook_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 		|| !is_valid_rown(row2) 
 		|| !is_valid_coln(col2)
 	);
-	bool (*has_obstruction)(Chess_Game*, int, int, int, int) = (
-		(row != row2) ? vertical_obstructed:horizontal_obstructed
-	);
 	return (
 		!invalid_params
 		&& (game->board[row2][col2].color != game->board[row][col].color)
-		&& ((row != row2) ^ (col != col2)) 
-		&& !has_obstruction(game, row, col, row2, col2)
+		&& (rook_attacks(square_index(row, col), game->occupied) 
+			& square_bb(square_index(row2, col2)))
 	);
 }
 bool rook_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
 	return rook_can_move(game, row, col, row2, col2);
 }
 
-Move rook_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	int max_pos_offsets;
-	int pos_offsets[32][2] = {0};
-	int i, j;
-	
+Scored_Move rook_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
 	// Return a null move upon invalid parameters
 	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
+		return Scored_Move_init0();
 	}
 	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	max_pos_offsets = 32; 
-	{
-		i = 0; 
-		j = 0;
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = i + 1;
-			pos_offsets[j][1] = 0;
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = -(i + 1);
-			pos_offsets[j][1] = 0;
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = 0;
-			pos_offsets[j][1] = i + 1;
-			++j;
-		}
-		for (i=0; i<max_pos_offsets/4; ++i){
-			pos_offsets[j][0] = 0;
-			pos_offsets[j][1] = -(i + 1);
-			++j;
-		}
-	}
+	// Return an optimal move among the attacked squares not held by allies
 	return piece_optimal_move(
 		game, row, col,
-		max_pos_offsets, pos_offsets, loss_class
+		rook_attacks(square_index(row, col), game->occupied)
+		& ~game->color_bbs[color_index(game->board[row][col].color)], 
+		loss_class
 	);
 }
 //   Pawn function(s)
@@ -915,18 +1758,9 @@ bool pawn_can_move(Chess_Game* game, int row, int col, int row2, int col2){
 		|| !is_valid_rown(row2) 
 		|| !is_valid_coln(col2)
 	);
-	int forward = invalid_params 
-				  ? 0
-				  : (game->board[row][col].color == WHITE) 
-				  	? FORWARD_WHITE:FORWARD_BLACK;
 	return (
 		(!invalid_params
-		&& correct_direction(forward, row, row2)
-		&& (col == col2)
-		&& (row != row2)
-		&& game->board[row2][col].color == NO_COLOR
-		&& ((row2 - row)*(row2 - row) <= 4)
-		&& !vertical_obstructed(game, row, col, row2, col2))
+		&& (pawn_push_targets(game, row, col) & square_bb(square_index(row2, col2))))
 		|| pawn_can_capture(game, row, col, row2, col2)
 	);
 }
@@ -937,68 +1771,31 @@ bool pawn_can_capture(Chess_Game* game, int row, int col, int row2, int col2){
 		|| !is_valid_rown(row2) 
 		|| !is_valid_coln(col2)
 	);
-	int forward = invalid_params 
-				  ? 0
-				  : (game->board[row][col].color == WHITE) 
-				  	? FORWARD_WHITE:FORWARD_BLACK;
 	return (
 		!invalid_params
-		&& correct_direction(forward, row, row2)
 		&& game->board[row2][col2].color != NO_COLOR
 		&& game->board[row][col].color != game->board[row2][col2].color
-		&& ((col2 - col)*(col2 - col) == 1)
-		&& ((row2 - row)*(row2 - row) == 1)
+		&& (pawn_attack_table[color_index(game->board[row][col].color)][square_index(row, col)]
+			& square_bb(square_index(row2, col2)))
 	);
 }
 
-Move pawn_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
-	char piece_color;
-	int forward;
-	int max_pos_offsets;
-	int min_pos_offsets;
-	int pos_offsets[4][2];
+Scored_Move pawn_optimal_move(Chess_Game* game, int row, int col, byte loss_class){
+	int color;
 	
 	// Return a null move upon invalid parameters
 	if (!is_valid_rown(row) || !is_valid_coln(col)){
-		return Move_init0();
+		return Scored_Move_init0();
 	}
 	
-	// Return an optimal move based on movement and capture
-	//  offset options
-	piece_color = game->board[row][col].color;
-	forward = (game->board[row][col].color == WHITE) 
-			  ? FORWARD_WHITE:FORWARD_BLACK;
-	pos_offsets[0][0] = 1*forward;
-	pos_offsets[1][0] = 2*forward;
-	pos_offsets[0][1] = pos_offsets[1][1] = 0;
-	max_pos_offsets = 4; 
-	min_pos_offsets = 2; // When no captures can happen
-	{
-		if (is_valid_rown(row + 1*forward)){
-			int fwd_row = row + 1*forward;
-			int left_col = col - 1;
-			int right_col = col + 1;
-			
-			if (is_valid_coln(left_col)
-				&& are_enemies(game->board[row][col], game->board[fwd_row][left_col]))
-			{
-				pos_offsets[min_pos_offsets][0] = 1*forward;
-				pos_offsets[min_pos_offsets][1] = -1;
-				min_pos_offsets += 1;
-			}
-			if (is_valid_coln(right_col)
-				&& are_enemies(game->board[row][col], game->board[fwd_row][right_col]))
-			{
-				pos_offsets[min_pos_offsets][0] = 1*forward;
-				pos_offsets[min_pos_offsets][1] = 1;
-				min_pos_offsets += 1;
-			}
-		}
-		max_pos_offsets = min_pos_offsets;
-	}
+	// Return an optimal move among the forward steps and the 
+	//  diagonal captures of enemy pieces
+	color = color_index(game->board[row][col].color);
 	return piece_optimal_move(
 		game, row, col,
-		max_pos_offsets, pos_offsets, loss_class
+		pawn_push_targets(game, row, col)
+		| (pawn_attack_table[color][square_index(row, col)] & game->color_bbs[!color]), 
+		loss_class
 	);
 }
 
@@ -1024,72 +1821,419 @@ void Chess_Game_print(Chess_Game* game){
 	}
 }
 
-//   Forward declarations
-Move Chess_Game_cpu_move(Chess_Game* game, char color, bool no_render);
+//   Conversions between notated and packed moves(only done at the API boundary)
+Packed_Move Move_pack(Move m){
+	if (m.subject_color == NO_COLOR){
+		return NULL_PACKED_MOVE;
+	}
+	return pack_move(
+		square_index(m.start[0], m.start[1]), 
+		square_index(m.stop[0], m.stop[1]),
+		m.promotion ? rank_index(m.subject_next_rank):0,
+		m.capture
+	);
+}
+
+//    Write a move in coordinate notation(e.g. e2e4 or a7a8q) followed by a '\0'.
+//     Needs room for COORDINATE_NOTATION_LENGTH + 1 characters
+void Packed_Move_coordinates(Packed_Move pm, char* buffer){
+	int from = packed_move_from(pm);
+	int to = packed_move_to(pm);
+	buffer[0] = get_colc(square_col(from));
+	buffer[1] = get_rowc(square_row(from));
+	buffer[2] = get_colc(square_col(to));
+	buffer[3] = get_rowc(square_row(to));
+	buffer[4] = packed_move_promotion(pm) ? rank_labels[packed_move_promotion(pm)] - 'A' + 'a':'\0';
+	buffer[5] = '\0';
+}
+
+//    Notate a move against the board it is about to be played on
+Move Chess_Game_notate_move(Chess_Game* game, Packed_Move pm){
+	int from = packed_move_from(pm);
+	int to = packed_move_to(pm);
+	Piece self = game->board[square_row(from)][square_col(from)];
+	bool capture = packed_move_is_capture(pm);
+	bool promotion = (packed_move_promotion(pm) != 0);
+	if (pm == NULL_PACKED_MOVE){
+		return Move_init0();
+	}
+	return Move_init10(
+		self, square_row(from), square_col(from), square_row(to), square_col(to),
+		capture, capture ? game->board[square_row(to)][square_col(to)]:Piece_init0(),
+		promotion, 
+		promotion ? Piece_init2(self.color, rank_labels[packed_move_promotion(pm)]):Piece_init0(),
+		0
+	);
+}
+
+//   Move generation
+//    Add the moves from one square to a set of targets, expanding promotions
+//    into one move per rank a pawn can become
+void Move_List_add_targets(
+	Move_List* list, Chess_Game* game, int from, 
+	bitboard targets, bool promotes
+){
+	int to;
+	int promotion;
+	bool capture;
+	while (targets && list->count < MAX_MOVES){
+		to = bitboard_lsb(targets);
+		targets &= targets - 1;
+		capture = (game->occupied & square_bb(to)) != 0;
+		if (!promotes){
+			list->moves[list->count++] = pack_move(from, to, 0, capture);
+			continue;
+		}
+		for (promotion=QUEEN_INDEX; promotion<PAWN_INDEX && list->count < MAX_MOVES; ++promotion){
+			list->moves[list->count++] = pack_move(from, to, promotion, capture);
+		}
+	}
+}
+
+#ifndef __KERNEL__
+//    Fill a list with every pseudo-legal move of a color(moves follow the 
+//    can_move rules but may leave the mover's own king attacked).
+//     Only perft uses it, to check the legal generator against
+void Chess_Game_generate_moves(Chess_Game* game, char color, Move_List* list){
+	int ci = color_index(color);
+	int i;
+	int sq;
+	bitboard targets;
+	bitboard promotion_row = (color == WHITE) ? TOP_ROW_BB:BOTTOM_ROW_BB;
+	bitboard pawns = game->rank_bbs[PAWN_INDEX];
+	list->count = 0;
+	for (i=0; i<game->piece_counts[ci]; ++i){
+		sq = game->piece_lists[ci][i];
+		targets = Chess_Game_piece_targets(game, sq);
+		// Only pawns reaching the last row promote
+		if (pawns & square_bb(sq)){
+			Move_List_add_targets(list, game, sq, targets & ~promotion_row, false);
+			Move_List_add_targets(list, game, sq, targets & promotion_row, true);
+		}else{
+			Move_List_add_targets(list, game, sq, targets, false);
+		}
+	}
+}
+#endif
+
+//    Find the pinned pieces and check evasion squares of a color
+void Chess_Game_legality_masks(Chess_Game* game, char color, Legality_Masks* masks){
+	int ci = color_index(color);
+	bitboard king = game->rank_bbs[KING_INDEX] & game->color_bbs[ci];
+	bitboard enemies = game->color_bbs[!ci];
+	bitboard queens = game->rank_bbs[QUEEN_INDEX];
+	bitboard snipers;
+	bitboard blockers;
+	int sniper;
+	masks->color = color;
+	masks->checkers = 0;
+	masks->check_mask = ~0ULL;
+	masks->pinned = 0;
+	if (!king){ // Without a king nothing can be exposed
+		masks->king_sq = -1;
+		return;
+	}
+	masks->king_sq = bitboard_lsb(king);
+	
+	// Only a capture of the checker or a block can answer a single check,
+	//  while only the king can answer a double check
+	masks->checkers = Chess_Game_attackers_to(
+		game, masks->king_sq, game->occupied, other_color(color)
+	);
+	if (masks->checkers){
+		masks->check_mask = (bitboard_count(masks->checkers) > 1) ? 0 : (
+			masks->checkers | between_bb(masks->king_sq, bitboard_lsb(masks->checkers))
+		);
+	}
+	
+	// An ally is pinned when it is the only piece between the king and 
+	//  an enemy slider that would otherwise attack the king
+	snipers = enemies & (
+		(rook_attacks(masks->king_sq, enemies) & (game->rank_bbs[ROOK_INDEX] | queens))
+		| (bishop_attacks(masks->king_sq, enemies) & (game->rank_bbs[BISHOP_INDEX] | queens))
+	);
+	while (snipers){
+		sniper = bitboard_lsb(snipers);
+		snipers &= snipers - 1;
+		blockers = between_bb(masks->king_sq, sniper) & game->occupied;
+		if (bitboard_count(blockers) == 1 && (blockers & game->color_bbs[ci])){
+			masks->pinned |= blockers;
+		}
+	}
+}
+
+//    The squares the occupant of a square can legally move to
+bitboard Chess_Game_legal_targets(Chess_Game* game, int sq, const Legality_Masks* masks){
+	bitboard targets = Chess_Game_piece_targets(game, sq);
+	bitboard safe = 0;
+	bitboard occupied;
+	int to;
+	
+	// The king can't step onto attacked squares, including the squares behind it
+	//  on a checking slider's line, so it is taken off the board while looking
+	if (sq == masks->king_sq){
+		occupied = game->occupied ^ square_bb(sq);
+		while (targets){
+			to = bitboard_lsb(targets);
+			targets &= targets - 1;
+			if (!Chess_Game_attackers_to(game, to, occupied, other_color(masks->color))){
+				safe |= square_bb(to);
+			}
+		}
+		return safe;
+	}
+	
+	// Other pieces have to answer any check and can't leave a pin's line
+	targets &= masks->check_mask;
+	if (masks->pinned & square_bb(sq)){
+		targets &= ray_table[ray_direction(masks->king_sq, sq)][masks->king_sq];
+	}
+	return targets;
+}
+
+//    Fill a list with every legal move of a color
+void Chess_Game_generate_legal_moves(Chess_Game* game, char color, Move_List* list){
+	Legality_Masks masks;
+	int ci = color_index(color);
+	int i;
+	int sq;
+	bitboard promotion_row = (color == WHITE) ? TOP_ROW_BB:BOTTOM_ROW_BB;
+	bitboard pawns = game->rank_bbs[PAWN_INDEX];
+	bitboard targets;
+	Chess_Game_legality_masks(game, color, &masks);
+	list->count = 0;
+	for (i=0; i<game->piece_counts[ci]; ++i){
+		sq = game->piece_lists[ci][i];
+		targets = Chess_Game_legal_targets(game, sq, &masks);
+		if (pawns & square_bb(sq)){
+			Move_List_add_targets(list, game, sq, targets & ~promotion_row, false);
+			Move_List_add_targets(list, game, sq, targets & promotion_row, true);
+		}else{
+			Move_List_add_targets(list, game, sq, targets, false);
+		}
+	}
+}
+
+//    Fill a list with every legal capture of a color plus its promotions to queen
+//     (the moves that change the material balance the most)
+void Chess_Game_generate_legal_captures(Chess_Game* game, char color, Move_List* list){
+	Legality_Masks masks;
+	int ci = color_index(color);
+	int i;
+	int sq;
+	int to;
+	bitboard promotion_row = (color == WHITE) ? TOP_ROW_BB:BOTTOM_ROW_BB;
+	bitboard pawns = game->rank_bbs[PAWN_INDEX];
+	bitboard enemies = game->color_bbs[!ci];
+	bitboard targets;
+	Chess_Game_legality_masks(game, color, &masks);
+	list->count = 0;
+	for (i=0; i<game->piece_counts[ci]; ++i){
+		sq = game->piece_lists[ci][i];
+		targets = Chess_Game_legal_targets(game, sq, &masks);
+		if (!(pawns & square_bb(sq))){
+			Move_List_add_targets(list, game, sq, targets & enemies, false);
+			continue;
+		}
+		Move_List_add_targets(list, game, sq, targets & enemies & ~promotion_row, false);
+		targets &= promotion_row;
+		while (targets && list->count < MAX_MOVES){
+			to = bitboard_lsb(targets);
+			targets &= targets - 1;
+			list->moves[list->count++] = pack_move(
+				sq, to, QUEEN_INDEX, (enemies & square_bb(to)) != 0
+			);
+		}
+	}
+}
+
+//    Check if a color's king is attacked
+bool Chess_Game_in_check(Chess_Game* game, char color){
+	bitboard king = game->rank_bbs[KING_INDEX] & game->color_bbs[color_index(color)];
+	return king && Chess_Game_attackers_to(
+		game, bitboard_lsb(king), game->occupied, other_color(color)
+	);
+}
+
+//    Check if a color has any legal move without listing them all
+bool Chess_Game_has_legal_move(Chess_Game* game, char color){
+	Legality_Masks masks;
+	int ci = color_index(color);
+	int i;
+	Chess_Game_legality_masks(game, color, &masks);
+	for (i=0; i<game->piece_counts[ci]; ++i){
+		if (Chess_Game_legal_targets(game, game->piece_lists[ci][i], &masks)){
+			return true;
+		}
+	}
+	return false;
+}
+
+//    Check if a move is legal for the color moving
+bool Chess_Game_is_legal_move(Chess_Game* game, Packed_Move pm, char color){
+	Legality_Masks masks;
+	int from = packed_move_from(pm);
+	if (game->board[square_row(from)][square_col(from)].color != color){
+		return false;
+	}
+	Chess_Game_legality_masks(game, color, &masks);
+	return (Chess_Game_legal_targets(game, from, &masks) & square_bb(packed_move_to(pm))) != 0;
+}
 
 //   Definitions
-Chess_Game Chess_Game_init2(char player_color, char cpu_color){
-	// Initialize rand
-	srand(time(NULL));
+void Chess_Game_init(Chess_Game* game, char player_color, char cpu_color){
+	// Fill the shared attack tables, Zobrist keys and piece-square scores on first use
+	init_attack_tables();
+	init_zobrist_keys();
+	init_piece_square_scores();
 
-	// Initialize and return the game object
-	Chess_Game game;
+	// Initialize the game object in place(it is too large to return by value 
+	//  from the kernel module's stack)
 	int i, j;
 	
+	//  Seed the game's random number generator
+	game->rng_state = (unsigned long long)time(NULL);
+	
 	//  Initialize the board to contain the pieces in their starting positions
     //   Place black pieces at the top
-    game.board[0][0] = Piece_init2(BLACK, ROOK);
-    game.board[0][1] = Piece_init2(BLACK, KNIGHT);
-    game.board[0][2] = Piece_init2(BLACK, BISHOP);
-    game.board[0][3] = Piece_init2(BLACK, QUEEN);
-    game.board[0][4] = Piece_init2(BLACK, KING);
-    game.board[0][5] = Piece_init2(BLACK, BISHOP);
-    game.board[0][6] = Piece_init2(BLACK, KNIGHT);
-    game.board[0][7] = Piece_init2(BLACK, ROOK);
+    game->board[0][0] = Piece_init2(BLACK, ROOK);
+    game->board[0][1] = Piece_init2(BLACK, KNIGHT);
+    game->board[0][2] = Piece_init2(BLACK, BISHOP);
+    game->board[0][3] = Piece_init2(BLACK, QUEEN);
+    game->board[0][4] = Piece_init2(BLACK, KING);
+    game->board[0][5] = Piece_init2(BLACK, BISHOP);
+    game->board[0][6] = Piece_init2(BLACK, KNIGHT);
+    game->board[0][7] = Piece_init2(BLACK, ROOK);
     for (i=0; i<BOARD_SIZE; i++) {
-        game.board[1][i] = Piece_init2(BLACK, PAWN);
+        game->board[1][i] = Piece_init2(BLACK, PAWN);
     }
     //  Place white pieces at the bottom
-    game.board[7][0] = Piece_init2(WHITE, ROOK);
-    game.board[7][1] = Piece_init2(WHITE, KNIGHT);
-    game.board[7][2] = Piece_init2(WHITE, BISHOP);
-    game.board[7][3] = Piece_init2(WHITE, QUEEN);
-    game.board[7][4] = Piece_init2(WHITE, KING);
-    game.board[7][5] = Piece_init2(WHITE, BISHOP);
-    game.board[7][6] = Piece_init2(WHITE, KNIGHT);
-    game.board[7][7] = Piece_init2(WHITE, ROOK);
+    game->board[7][0] = Piece_init2(WHITE, ROOK);
+    game->board[7][1] = Piece_init2(WHITE, KNIGHT);
+    game->board[7][2] = Piece_init2(WHITE, BISHOP);
+    game->board[7][3] = Piece_init2(WHITE, QUEEN);
+    game->board[7][4] = Piece_init2(WHITE, KING);
+    game->board[7][5] = Piece_init2(WHITE, BISHOP);
+    game->board[7][6] = Piece_init2(WHITE, KNIGHT);
+    game->board[7][7] = Piece_init2(WHITE, ROOK);
     for (i=0; i<BOARD_SIZE; i++) {
-        game.board[6][i] = Piece_init2(WHITE, PAWN);
+        game->board[6][i] = Piece_init2(WHITE, PAWN);
     }
     // Initialize the rest of the board with empty pieces
     for (i=2; i<6; i++) {
         for (j=0; j<BOARD_SIZE; j++) {
-            game.board[i][j] = Piece_init0();
+            game->board[i][j] = Piece_init0();
         }
     }
+	//  The player moves first
+	game->side_to_move = player_color;
+	//  Build the occupancy bitboards and the key from the board
+	Chess_Game_refresh_bitboards(game);
 	// Set the check statuses and the location of the 2 kings
-	game.cpu_king_loc[0] = 0;
-	game.player_king_loc[0] = 7;
-	game.cpu_king_loc[1] = game.player_king_loc[1] = 4;
-	game.checked_color = game.checkmated_color = NO_COLOR;
+	game->cpu_king_loc[0] = 0;
+	game->player_king_loc[0] = 7;
+	game->cpu_king_loc[1] = game->player_king_loc[1] = 4;
+	game->check = game->checkmate = false;
+	game->checked_color = game->checkmated_color = NO_COLOR;
 	// Set the colors of the player and cpu
-	game.player_color = player_color;
-	game.cpu_color = cpu_color;
+	game->player_color = player_color;
+	game->cpu_color = cpu_color;
 	// Initialize the last move to a null move
-	game.last_move = Move_init0();
+	game->last_move = NULL_PACKED_MOVE;
+	// Nothing has been made yet so nothing can be unmade
+	game->undo_count = 0;
+}
 
-	// Return the board
-	return game;
+#ifndef __KERNEL__
+//    Replace the board with a FEN piece placement(e.g. "8/8/8/8/8/8/8/R3K2k").
+//     Only the userspace tools(perft, bench) set up positions this way.
+//     The placement is checked in full before the board is touched, so malformed 
+//     ones(unknown letters, rows that aren't 8 squares wide, more than MAX_PIECES 
+//     pieces or other than 1 king for a color) return false and change nothing
+bool Chess_Game_load_placement(Chess_Game* game, const char* placement){
+	Piece board[BOARD_SIZE][BOARD_SIZE];
+	int piece_counts[2] = {0, 0};
+	int king_counts[2] = {0, 0};
+	int row = 0;
+	int col = 0;
+	int i;
+	int j;
+	char c;
+	for (i=0; i<BOARD_SIZE; ++i){
+		for (j=0; j<BOARD_SIZE; ++j){
+			board[i][j] = Piece_init0();
+		}
+	}
+	for (; *placement; ++placement){
+		c = *placement;
+		if (c == '/'){
+			if (col != BOARD_SIZE || ++row >= BOARD_SIZE){
+				return false;
+			}
+			col = 0;
+		}else if (c >= '1' && c <= '8'){
+			if ((col += c - '0') > BOARD_SIZE){
+				return false;
+			}
+		}else{
+			if (col >= BOARD_SIZE){
+				return false;
+			}
+			// Uppercase pieces are white and lowercase pieces are black
+			board[row][col] = (c >= 'a' && c <= 'z') 
+							  ? Piece_init2(BLACK, c - 'a' + 'A'):Piece_init2(WHITE, c);
+			if (!is_valid_rank(board[row][col].rank) 
+				|| ++piece_counts[color_index(board[row][col].color)] > MAX_PIECES)
+			{
+				return false;
+			}
+			if (board[row][col].rank == KING){
+				++king_counts[color_index(board[row][col].color)];
+			}
+			++col;
+		}
+	}
+	if (row != BOARD_SIZE - 1 || col != BOARD_SIZE 
+		|| king_counts[WHITE_INDEX] != 1 || king_counts[BLACK_INDEX] != 1)
+	{
+		return false;
+	}
+	
+	// Place the pieces, keeping the kings' locations in sync with the board.
+	//  The board is emptied first so no color's piece list overfills on the way
+	for (i=0; i<BOARD_SIZE; ++i){
+		for (j=0; j<BOARD_SIZE; ++j){
+			Chess_Game_set_piece(game, i, j, Piece_init0());
+		}
+	}
+	for (i=0; i<BOARD_SIZE; ++i){
+		for (j=0; j<BOARD_SIZE; ++j){
+			Chess_Game_set_piece(game, i, j, board[i][j]);
+			if (board[i][j].rank == KING){
+				if (board[i][j].color == game->player_color){
+					game->player_king_loc[0] = i;
+					game->player_king_loc[1] = j;
+				}else{
+					game->cpu_king_loc[0] = i;
+					game->cpu_king_loc[1] = j;
+				}
+			}
+		}
+	}
+	return true;
 }
+#endif
 
-Move Chess_Game_render_move(
-	Chess_Game* game, Move m, bool no_self_check, 
-	char color, bool validate
+//   Render a move that is already known to follow the movement rules and 
+//    update the game statuses. Returns false and leaves the game untouched 
+//    when the move is null or is a prohibited self-check
+bool Chess_Game_render_packed_move(
+	Chess_Game* game, Packed_Move pm, 
+	bool no_self_check, char color
 ){
-	bool must_capture;
-	bool must_promote;
+	Piece mover = game->board[square_row(packed_move_from(pm))][square_col(packed_move_from(pm))];
 	int* king_loc;
-	bool checkmate;
+	bool checkmate = false;
 	bool check;
 	int i;
 	char colors[2] = {color, other_color(color)};
@@ -1099,6 +2243,62 @@ Move Chess_Game_render_move(
 		(color == game->player_color) 
 		? game->cpu_king_loc:game->player_king_loc
 	};
+
+	// Don't process null moves
+	if (pm == NULL_PACKED_MOVE){
+		return false;
+	}
+
+	// Reject prohibited self-checks up front
+	if (no_self_check && !Chess_Game_is_legal_move(game, pm, mover.color)){
+		return false;
+	}
+
+	// Render the move(this also tracks the king's location)
+	if (!Chess_Game_make_move(game, pm)){
+		return false;
+	}
+
+	// For each color, determine/update its statuses if it is checkmated or in check
+	{
+		for (i=0; i<2; ++i){
+			king_loc = king_locs[i];
+			check = can_capture(game, king_loc[0], king_loc[1]);
+			// If the player puts themself in check, it's essentially checkmate as the cpu
+			//  will take their king on its turn. This is only reached when it's allowed
+			if (check && mover.color == colors[i]){
+				checkmate = true;
+			}
+			// Update the game statuses for check, checkmate, etc.
+			//  The side about to move is checkmated when it has no legal move
+			checkmate = (
+				checkmate
+				|| (colors[i] != mover.color && !Chess_Game_has_legal_move(game, colors[i]))
+			);
+			game->check = check;
+			game->checkmate = checkmate;
+			game->checkmated_color = game->checkmate ? colors[i]:NO_COLOR;
+			game->checked_color = game->check ? colors[i]:NO_COLOR;
+			// Stop once a check[mate] state has ocurred
+			if (game->check || game->checkmate){ 
+				break;
+			}
+		}
+	}
+
+	// Rendered moves are permanent so their undo record is dropped
+	--game->undo_count;
+
+	return true;
+}
+
+//   Render a notated move(e.g. the player's), validating it first if requested
+Move Chess_Game_render_move(
+	Chess_Game* game, Move m, bool no_self_check, 
+	char color, bool validate
+){
+	bool must_capture;
+	bool must_promote;
 	Piece_Attributes pa;
 
 	// Don't process null moves
@@ -1144,103 +2344,844 @@ Move Chess_Game_render_move(
 		}
 	}
 
-	// Render the move
-	//  Render the actual movement and possible capture
-	game->board[m.stop[0]][m.stop[1]] = game->board[m.start[0]][m.start[1]];
-	game->board[m.start[0]][m.start[1]] = Piece_init0();
-	//  Render promotions
-	if (m.promotion){
-		game->board[m.stop[0]][m.stop[1]] = (
-			Piece_init2(m.subject_color, m.subject_next_rank)
-		);
+	// Render the move in its packed form
+	if (!Chess_Game_render_packed_move(game, Move_pack(m), no_self_check, color)){
+		return Move_init0();
 	}
 
-	// Update the appropriate king's location to be used later if the king was moved
-	if (m.subject_prev_rank == KING){
-		king_locs[0][0] = m.stop[0];
-		king_locs[0][1] = m.stop[1];
+	// Return the move as it came in, thereby indicating its validity
+	return m;
+}
+
+
+//    Pick the move with the highest immediate gain(1 ply minus the best reply's gain)
+Packed_Move Chess_Game_greedy_move(Chess_Game* game, char color){
+	// Find an optimal move.
+	//  Choose the first move with the highest gain
+	Scored_Move optimal_move = Scored_Move_init0();
+	int i;
+	int sq;
+	Scored_Move curr_move;
+	// Only consider legal moves
+	Legality_Masks masks;
+	// Only visit the ally pieces. The list is copied since evaluating a move
+	//  temporarily enacts it, which reorders the lists
+	byte allies[MAX_PIECES];
+	int ally_count = game->piece_counts[color_index(color)];
+	for (i=0; i<ally_count; ++i){
+		allies[i] = game->piece_lists[color_index(color)][i];
 	}
+	Chess_Game_legality_masks(game, color, &masks);
+	
+	for (i=0; i<ally_count && optimal_move.gain < MAX_GAIN; ++i){
+		sq = allies[i];
+		// Find an optimal move based on maximum gain.
+		//  When moves are equally optimal, switch to the other move
+		//  somewhat randomly
+		curr_move = piece_optimal_move(
+			game, square_row(sq), square_col(sq), 
+			Chess_Game_legal_targets(game, sq, &masks), ALL_LOSS
+		);
+		if (curr_move.gain > optimal_move.gain 
+			|| (curr_move.gain == optimal_move.gain 
+				&& (unsigned int)random_next(&game->rng_state) % 32 == 0))
+		{
+			optimal_move = curr_move;
+		}
+	}
+	
+	return optimal_move.move;
+}
 
-	// For each color, determine/update its statuses if it is checkmated or in check
+//   Search(negamax alpha-beta with iterative deepening).
+//    Scores are in centipawns from the side to move's point of view
+#define MAX_PLY 64 // Deepest line a search follows(must stay below UNDO_STACK_SIZE)
+#define MATE_SCORE 100000 // Minus the plies to mate so quicker mates score higher
+#define INFINITE_SCORE (MATE_SCORE + 1)
+#define is_mate_score(score) ((score) > MATE_SCORE - MAX_PLY || (score) < -MATE_SCORE + MAX_PLY)
+#define DEFAULT_SEARCH_DEPTH 4
+#define MAX_SEARCH_DEPTH (MAX_PLY - 1) // For searches bounded only by time or nodes
+#define CLOCK_CHECK_INTERVAL 1024 // Nodes between looks at the clock(and, in the kernel, yields)
+//    Move ordering scores(higher is searched first).
+//     Captures are ordered by MVV-LVA: most valuable victim first, then least valuable attacker
+#define HASH_MOVE_SCORE (1 << 30)
+#define CAPTURE_SCORE (1 << 28)
+#define MVV_LVA_SCALE 1024 // More than any attacker's value so victims dominate
+#define KILLER_SCORE (1 << 27) // Followed by the second killer
+#define KILLER_COUNT 2
+#define DELTA_MARGIN (2 * PAWN_SCORE) // Slack a capture gets when checking if it could matter
+//    Selective search(each part can be switched off through Search_Options)
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_REDUCTION 2 // Plus 1 more from NULL_MOVE_DEEP_DEPTH on
+#define NULL_MOVE_DEEP_DEPTH 7
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3 // Moves searched at full depth before reducing the rest
+#define FUTILITY_DEPTH 2 // Deepest remaining depth quiet moves can be pruned at
+#define FUTILITY_MARGIN (2 * PAWN_SCORE) // Per ply of remaining depth
+#define RAZOR_DEPTH 2
+#define RAZOR_MARGIN (3 * PAWN_SCORE) // Per ply of remaining depth
+//    Aspiration windows(iterations search a window around the last one's score,
+//     widening it after each failure)
+#define ASPIRATION_MIN_DEPTH 4
+#define ASPIRATION_WINDOW (PAWN_SCORE / 2)
+
+//   Monotonic clock in nanoseconds(for search deadlines)
+unsigned long long monotonic_ns(void){
+#ifdef __KERNEL__
+	return ktime_get_ns();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+//   Search_Options class(how Chess_Game_cpu_move searches).
+//    The search deepens until it reaches depth or runs out of time or nodes,
+//    returning the best move of the deepest iteration it finished(the first
+//    iteration always finishes so there is a move)
+typedef struct Search_Options{
+	int depth; // In plies(at most MAX_SEARCH_DEPTH)
+	unsigned long time_limit_ms; // Wall-clock time to search for(0 for no limit)
+	unsigned long long node_limit; // Nodes the main thread may search(0 for no limit)
+	int threads; // Searching the same position(Lazy SMP, userspace only)
+	bool null_move; // Prune when passing the turn still fails high
+	bool late_move_reductions; // Search late quiet moves shallower unless they raise alpha
+	bool futility_pruning; // Skip quiet moves near the leaves when far below alpha
+	bool razoring; // Drop straight into quiescence near the leaves when far below alpha
+	// Set by another thread to end the search early(NULL when nothing can). 
+	//  Unlike the limits this can stop the first iteration, leaving no move
+	const bool* stop;
+} Search_Options;
+Search_Options Search_Options_init0(void){
+	return (Search_Options){DEFAULT_SEARCH_DEPTH, 0, 0, 1, true, true, true, true, NULL};
+}
+
+//   Search_Report class(what a search did, so options can be compared)
+typedef struct Search_Report{
+	Packed_Move best_move;
+	int score; // In centipawns for the side that searched
+	int depth; // Deepest finished iteration
+	unsigned long long nodes; // Including quiescence nodes and every thread's
+	unsigned long time_ms; // Wall-clock time spent
+	// Principal variation: the line both sides are expected to play, starting
+	//  with best_move(may be cut short by transposition table hits)
+	Packed_Move pv[MAX_PLY];
+	int pv_length;
+} Search_Report;
+#define HISTORY_LIMIT (1 << 26) // History scores are halved once one reaches this
+
+//    Everything a search keeps besides the game(kept off the stack since it is large)
+typedef struct Search_State{
+	Chess_Game* game;
+	Move_List move_lists[MAX_PLY]; // One per ply
+	int move_scores[MAX_PLY][MAX_MOVES]; // Ordering scores of the moves in move_lists
+	// Quiet moves that caused a cutoff at each ply(most recent first)
+	Packed_Move killers[MAX_PLY][KILLER_COUNT];
+	// How often each quiet move(by color, origin and destination) caused a cutoff, 
+	//  weighted by depth
+	int history[2][SQUARE_COUNT][SQUARE_COUNT];
+	// Triangular principal variation table: pv[ply] holds the best line found
+	//  from ply onwards, in pv[ply][ply] to pv[ply][pv_lengths[ply] - 1]
+	Packed_Move pv[MAX_PLY][MAX_PLY];
+	int pv_lengths[MAX_PLY];
+	Search_Options options;
+	Packed_Move best_move; // At the root, from the last finished iteration
+	int best_score;
+	int depth; // Of the last finished iteration
+	int depth_offset; // Plies each iteration searches beyond its number
+	unsigned long long nodes;
+	// The root's principal variation as of the last finished iteration
+	Packed_Move best_pv[MAX_PLY];
+	int best_pv_length;
+	// Limits from the options(0 for none). Once the search passes one or 
+	//  another thread sets stop(NULL when nothing can), it unwinds 
+	//  without storing anything
+	unsigned long long deadline_ns;
+	unsigned long long node_limit;
+	const bool* stop;
+	bool stopped;
+} __attribute__((aligned(CACHE_LINE_SIZE))) Search_State;
+
+//    Check if the search has to stop. Limits only apply once the first iteration
+//     has finished so there is always a move to return
+bool Search_State_stopped(Search_State* state){
+#ifdef __KERNEL__
+	// Searches run inside a write() to the proc file, so yield the CPU every
+	//  so often rather than hold it for the whole search
+	if (!(state->nodes & (CLOCK_CHECK_INTERVAL - 1))){
+		cond_resched();
+	}
+#endif
+	if (!state->stopped && (
+			(state->stop && __atomic_load_n(state->stop, __ATOMIC_RELAXED))
+			|| (state->depth > 0 && (
+				(state->node_limit && state->nodes >= state->node_limit)
+				|| (state->deadline_ns && !(state->nodes & (CLOCK_CHECK_INTERVAL - 1))
+					&& monotonic_ns() >= state->deadline_ns)
+			))
+		))
 	{
-		for (i=0; i<2; ++i){
-			king_loc = king_locs[i];
-			check = can_capture(game, king_loc[0], king_loc[1]);
-			// If the player puts themself in check, it's essentially checkmate as the cpu
-			//  will take their king on its turn. This may or may not be allowed
-			if (check && m.subject_color == colors[i]){
-				// If we aren't allowed to check themselves, thensimply undo the move
-				//  and return a null move
-				if (no_self_check){
-					game->board[m.start[0]][m.start[1]] = Piece_init2(m.subject_color, m.subject_prev_rank);
-					game->board[m.stop[0]][m.stop[1]] = Piece_init2(m.captured_color, m.captured_rank);
-					return Move_init0();
-				}
-				// Otherwise, declare checkmate
-				else{
-					checkmate = true;
-				}
-			}
-			// Update the game statuses for check, checkmate, etc
-			checkmate = (
-				checkmate
-				|| Chess_Game_cpu_move(game, color, true).gain == NULL_GAIN
-			);
-			game->check = check;
-			game->checkmate = checkmate;
-			game->checkmated_color = game->checkmate ? colors[i]:NO_COLOR;
-			game->checked_color = game->check ? colors[i]:NO_COLOR;
-			// Stop once a check[mate] state has ocurred
-			if (game->check || game->checkmate){ 
-				break;
+		state->stopped = true;
+	}
+	return state->stopped;
+}
+
+//    Material a move takes plus what a promotion adds(before any recapture)
+int Chess_Game_capture_gain(Chess_Game* game, Packed_Move pm){
+	int to = packed_move_to(pm);
+	int promotion = packed_move_promotion(pm);
+	return piece_value(game->board[square_row(to)][square_col(to)].rank)
+		   + (promotion ? piece_value(rank_labels[promotion]) - PAWN_VALUE:0);
+}
+
+//    Score every move at a ply for ordering
+void Search_State_score_moves(Search_State* state, int ply, Packed_Move hash_move){
+	Chess_Game* game = state->game;
+	Move_List* list = &state->move_lists[ply];
+	int* scores = state->move_scores[ply];
+	int ci = color_index(game->side_to_move);
+	Packed_Move pm;
+	int from;
+	int to;
+	int attacker_value;
+	int gain;
+	int see;
+	int score;
+	int i;
+	for (i=0; i<list->count; ++i){
+		pm = list->moves[i];
+		from = packed_move_from(pm);
+		to = packed_move_to(pm);
+		if (pm == hash_move){
+			score = HASH_MOVE_SCORE;
+		}else if (packed_move_is_capture(pm) || packed_move_promotion(pm) == QUEEN_INDEX){
+			// Queen promotions are ordered like captures of what they gain.
+			//  Captures that lose the exchange go after every quiet move,
+			//  and only captures by pieces worth more than their victim can lose it
+			attacker_value = piece_value(game->board[square_row(from)][square_col(from)].rank);
+			gain = Chess_Game_capture_gain(game, pm);
+			see = (attacker_value > gain) ? Chess_Game_see(game, pm):0;
+			score = (see < 0) ? see:CAPTURE_SCORE + MVV_LVA_SCALE * gain - attacker_value;
+		}else if (pm == state->killers[ply][0]){
+			score = KILLER_SCORE + 1;
+		}else if (pm == state->killers[ply][1]){
+			score = KILLER_SCORE;
+		}else{
+			score = state->history[ci][from][to];
+		}
+		scores[i] = score;
+	}
+}
+
+//    Move the highest scoring of the moves not yet searched to the given index
+//     and return it(cheaper than sorting since most nodes cut off early)
+Packed_Move Search_State_next_move(Search_State* state, int ply, int index){
+	Move_List* list = &state->move_lists[ply];
+	int* scores = state->move_scores[ply];
+	int best = index;
+	Packed_Move pm;
+	int score;
+	int i;
+	for (i=index+1; i<list->count; ++i){
+		if (scores[i] > scores[best]){
+			best = i;
+		}
+	}
+	pm = list->moves[best];
+	score = scores[best];
+	list->moves[best] = list->moves[index];
+	scores[best] = scores[index];
+	list->moves[index] = pm;
+	scores[index] = score;
+	return pm;
+}
+
+//    Remember a quiet move that caused a cutoff
+void Search_State_reward_quiet(Search_State* state, int ply, int depth, Packed_Move pm){
+	int ci = color_index(state->game->side_to_move);
+	int* history = &state->history[ci][packed_move_from(pm)][packed_move_to(pm)];
+	int i, j;
+	if (state->killers[ply][0] != pm){
+		state->killers[ply][1] = state->killers[ply][0];
+		state->killers[ply][0] = pm;
+	}
+	*history += depth * depth;
+	// Halve everything once a score grows too large so recent cutoffs still count
+	if (*history >= HISTORY_LIMIT){
+		for (i=0; i<SQUARE_COUNT; ++i){
+			for (j=0; j<SQUARE_COUNT; ++j){
+				state->history[ci][i][j] /= 2;
 			}
 		}
 	}
+}
 
-	// Update the game's last move
-	game->last_move = m;
+//    Make a move followed by the next ply's line the principal variation at a ply
+void Search_State_update_pv(Search_State* state, int ply, Packed_Move pm){
+	int i;
+	state->pv[ply][ply] = pm;
+	for (i=ply+1; i<state->pv_lengths[ply + 1]; ++i){
+		state->pv[ply][i] = state->pv[ply + 1][i];
+	}
+	state->pv_lengths[ply] = state->pv_lengths[ply + 1];
+}
 
-	// Return the move as it came in, thereby indicating its validity
-	return m;
+//    Pawn structure table.
+//     Pawn structures change far less often than positions, so their scores are 
+//     cached by pawn key and only worked out on a miss. Like the transposition
+//     table it is shared by every thread without locks, each entry storing its
+//     key XORed with its data
+#define PAWN_TABLE_SIZE (1 << 14) // Entries(a power of 2)
+#define DOUBLED_PAWN_PENALTY_MG 10 // Per pawn behind another on its file
+#define DOUBLED_PAWN_PENALTY_EG 20
+#define ISOLATED_PAWN_PENALTY_MG 10 // Per pawn with no allies on the files beside it
+#define ISOLATED_PAWN_PENALTY_EG 15
+#define FILE_BB 0x0101010101010101ULL // The a file
+//     Bonuses for a passed pawn(no enemy pawn can block or take it on its way) 
+//      by the rows it still has to go
+static const int passed_pawn_bonuses[2][BOARD_SIZE] = {
+	[MIDGAME] = {0, 60, 40, 25, 15, 10, 5, 0},
+	[ENDGAME] = {0, 120, 80, 50, 30, 20, 10, 0}
+};
+//     Entry data layout
+//      bits 0-31: midgame score
+//      bits 32-63: endgame score
+typedef struct Pawn_Entry{
+	unsigned long long check; // pawn_key ^ data
+	unsigned long long data;
+} Pawn_Entry;
+static Pawn_Entry pawn_table[PAWN_TABLE_SIZE];
+
+//     Score a color's pawns(midgame and endgame) from its point of view
+void Chess_Game_pawn_structure(Chess_Game* game, char color, int* midgame, int* endgame){
+	int ci = color_index(color);
+	bitboard pawns = game->rank_bbs[PAWN_INDEX] & game->color_bbs[ci];
+	bitboard enemy_pawns = game->rank_bbs[PAWN_INDEX] & game->color_bbs[!ci];
+	bitboard remaining = pawns;
+	bitboard files;
+	bitboard ahead;
+	int sq, row, col;
+	int rows_to_go;
+	*midgame = *endgame = 0;
+	while (remaining){
+		sq = bitboard_lsb(remaining);
+		remaining &= remaining - 1;
+		row = square_row(sq);
+		col = square_col(sq);
+		files = FILE_BB << col;
+		if (col > 0){
+			files |= FILE_BB << (col - 1);
+		}
+		if (col < BOARD_SIZE - 1){
+			files |= FILE_BB << (col + 1);
+		}
+		// White pawns head for row 0 and black pawns for the last row
+		if (color == WHITE){
+			ahead = square_bb(square_index(row, 0)) - 1;
+		}else{
+			ahead = square_bb(square_index(row, BOARD_SIZE - 1));
+			ahead = ~(ahead | (ahead - 1));
+		}
+		rows_to_go = (color == WHITE) ? row:BOARD_SIZE - 1 - row;
+		if (!(pawns & files & ~(FILE_BB << col))){
+			*midgame -= ISOLATED_PAWN_PENALTY_MG;
+			*endgame -= ISOLATED_PAWN_PENALTY_EG;
+		}
+		// Only the front pawn of a file can be passed
+		if (pawns & ahead & (FILE_BB << col)){
+			*midgame -= DOUBLED_PAWN_PENALTY_MG;
+			*endgame -= DOUBLED_PAWN_PENALTY_EG;
+		}else if (!(enemy_pawns & files & ahead)){
+			*midgame += passed_pawn_bonuses[MIDGAME][rows_to_go];
+			*endgame += passed_pawn_bonuses[ENDGAME][rows_to_go];
+		}
+	}
 }
 
-Move Chess_Game_cpu_move(Chess_Game* game, char color, bool no_render){
-	// Find an optimal move.
-	//  Choose the first Move with the highest gain
-	Move optimal_move = Move_init0();
-	int i, j;
-	Piece_Attributes pa;
-	Move curr_move;
+//     Look up the pawn structure's scores(white's minus black's), working them
+//      out and storing them on a miss
+void Chess_Game_pawn_scores(Chess_Game* game, int* midgame, int* endgame){
+	Pawn_Entry* entry = &pawn_table[game->pawn_key & (PAWN_TABLE_SIZE - 1)];
+	unsigned long long check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	unsigned long long data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+	int black_midgame, black_endgame;
+	if ((check ^ data) == game->pawn_key){
+		*midgame = (int)(unsigned int)(data & 0xFFFFFFFFULL);
+		*endgame = (int)(unsigned int)(data >> 32);
+		return;
+	}
+	Chess_Game_pawn_structure(game, WHITE, midgame, endgame);
+	Chess_Game_pawn_structure(game, BLACK, &black_midgame, &black_endgame);
+	*midgame -= black_midgame;
+	*endgame -= black_endgame;
+	data = (unsigned long long)(unsigned int)*midgame 
+		   | ((unsigned long long)(unsigned int)*endgame << 32);
+	__atomic_store_n(&entry->check, game->pawn_key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+//    Static evaluation of a quiet position from the side to move's point of view:
+//     the midgame and endgame scores(including the pawn structure's) blended by 
+//     the phase(promotions can push it past MAX_PHASE)
+int Chess_Game_evaluate(Chess_Game* game){
+	int phase = (game->phase < MAX_PHASE) ? game->phase:MAX_PHASE;
+	int pawn_midgame, pawn_endgame;
+	int score;
+	Chess_Game_pawn_scores(game, &pawn_midgame, &pawn_endgame);
+	score = (
+		(game->midgame_score + pawn_midgame) * phase 
+		+ (game->endgame_score + pawn_endgame) * (MAX_PHASE - phase)
+	) / MAX_PHASE;
+	return (game->side_to_move == WHITE) ? score:-score;
+}
+
+//    Mate scores are stored relative to the position rather than the root
+int score_to_tt(int score, int ply){
+	return (score > MATE_SCORE - MAX_PLY) ? score + ply
+		   : (score < -MATE_SCORE + MAX_PLY) ? score - ply:score;
+}
+int score_from_tt(int score, int ply){
+	return (score > MATE_SCORE - MAX_PLY) ? score - ply
+		   : (score < -MATE_SCORE + MAX_PLY) ? score + ply:score;
+}
+
+//    Search captures only until the position is quiet so leaves aren't scored
+//     in the middle of an exchange.
+//     The side to move may stand pat on the static evaluation instead of capturing,
+//     unless it is in check, in which case every evasion is searched
+int Chess_Game_quiesce(Search_State* state, int alpha, int beta, int ply){
+	Chess_Game* game = state->game;
+	Move_List* list = &state->move_lists[ply];
+	int* scores = state->move_scores[ply];
+	bool in_check = Chess_Game_in_check(game, game->side_to_move);
+	int best_score = -INFINITE_SCORE;
+	int stand_pat = -INFINITE_SCORE;
+	Packed_Move pm;
+	int score;
+	int i;
+	if (Search_State_stopped(state)){
+		return 0;
+	}
+	++state->nodes;
 	
-	for (i=0; i<BOARD_SIZE && optimal_move.gain < MAX_GAIN; ++i){
-		for (j=0; j<BOARD_SIZE && optimal_move.gain < MAX_GAIN; ++j){
-			// Skip non-ally pieces
-			if (game->board[i][j].color != color){
+	if (in_check){
+		Chess_Game_generate_legal_moves(game, game->side_to_move, list);
+	}else{
+		Chess_Game_generate_legal_captures(game, game->side_to_move, list);
+	}
+	// A side with no legal move has lost
+	if (!list->count && (in_check || !Chess_Game_has_legal_move(game, game->side_to_move))){
+		return -MATE_SCORE + ply;
+	}
+	if (ply >= MAX_PLY - 1){
+		return Chess_Game_evaluate(game);
+	}
+	if (!in_check){
+		best_score = stand_pat = Chess_Game_evaluate(game);
+		if (best_score >= beta){
+			return best_score;
+		}
+		if (best_score > alpha){
+			alpha = best_score;
+		}
+	}
+	
+	Search_State_score_moves(state, ply, NULL_PACKED_MOVE);
+	for (i=0; i<list->count; ++i){
+		pm = Search_State_next_move(state, ply, i);
+		if (!in_check){
+			// Moves are picked best first, so once one loses its exchange the rest do too
+			if (scores[i] < 0){
+				break;
+			}
+			// Skip captures that can't raise the score to alpha even when nothing is lost for them
+			if (stand_pat + DELTA_MARGIN + PAWN_SCORE * Chess_Game_capture_gain(game, pm) <= alpha){
 				continue;
 			}
-			// Find an optimal move based on maximum gain.
-			//  When moves are equally optimal, switch to the other move
-			//  somewhat randomly
-			pa = Piece_Attributes_init1(
-				game->board[i][j].rank
+		}
+		Chess_Game_make_move(game, pm);
+		score = -Chess_Game_quiesce(state, -beta, -alpha, ply + 1);
+		Chess_Game_unmake_move(game);
+		if (score > best_score){
+			best_score = score;
+			if (score > alpha){
+				alpha = score;
+				if (alpha >= beta){
+					break;
+				}
+			}
+		}
+	}
+	return best_score;
+}
+
+int Chess_Game_negamax(Search_State* state, int depth, int alpha, int beta, int ply){
+	Chess_Game* game = state->game;
+	const Search_Options* options = &state->options;
+	Move_List* list = &state->move_lists[ply];
+	int* scores = state->move_scores[ply];
+	char color = game->side_to_move;
+	int ci = color_index(color);
+	int alpha_orig = alpha;
+	bool pv_node = beta - alpha > 1; // Only the first line at each node gets an open window
+	int best_score = -INFINITE_SCORE;
+	int static_score = -INFINITE_SCORE;
+	Packed_Move best_move = NULL_PACKED_MOVE;
+	Packed_Move hash_move = NULL_PACKED_MOVE;
+	Packed_Move last_move;
+	Packed_Move pm;
+	TT_Hit hit;
+	bool in_check;
+	bool futile = false;
+	bool quiet;
+	bool gives_check;
+	int reduction;
+	int score;
+	int i;
+	
+	// Nothing has been found from here yet
+	state->pv_lengths[ply] = ply;
+	
+	// Leaves settle any captures before being evaluated
+	if (depth <= 0 || ply >= MAX_PLY - 1){
+		return Chess_Game_quiesce(state, alpha, beta, ply);
+	}
+	if (Search_State_stopped(state)){
+		return 0;
+	}
+	++state->nodes;
+	
+	// Reuse a deep enough earlier result when its bound settles the score.
+	//  The root always searches so it has a move to return
+	if (Transposition_Table_probe(&transposition_table, game->key, &hit)){
+		hash_move = hit.move;
+		score = score_from_tt(hit.score, ply);
+		if (ply > 0 && hit.depth >= depth 
+			&& (hit.bound == TT_EXACT
+				|| (hit.bound == TT_LOWER && score >= beta)
+				|| (hit.bound == TT_UPPER && score <= alpha)))
+		{
+			return score;
+		}
+	}
+	
+	// Prune hopeless lines. None of this applies in check, where every move has
+	//  to be looked at, or on the principal variation, which is searched exactly
+	in_check = Chess_Game_in_check(game, color);
+	if (!pv_node && !in_check){
+		static_score = Chess_Game_evaluate(game);
+		
+		//  Razoring: far below alpha near the leaves only captures can recover,
+		//   so trust quiescence when it agrees
+		if (options->razoring && depth <= RAZOR_DEPTH 
+			&& static_score + RAZOR_MARGIN * depth <= alpha)
+		{
+			score = Chess_Game_quiesce(state, alpha, beta, ply);
+			if (score <= alpha || state->stopped){
+				return score;
+			}
+		}
+		
+		//  Null move: if passing the turn still fails high with a shallower search,
+		//   a real move would too. Passing is only tried with pieces besides pawns
+		//   to move(where being forced to move rarely hurts) and never twice in a row
+		if (options->null_move && depth >= NULL_MOVE_MIN_DEPTH 
+			&& static_score >= beta && !is_mate_score(beta)
+			&& game->last_move != NULL_PACKED_MOVE
+			&& (game->color_bbs[ci] & ~(game->rank_bbs[PAWN_INDEX] | game->rank_bbs[KING_INDEX])))
+		{
+			reduction = NULL_MOVE_REDUCTION + (depth >= NULL_MOVE_DEEP_DEPTH);
+			last_move = game->last_move;
+			game->last_move = NULL_PACKED_MOVE;
+			Chess_Game_set_side_to_move(game, other_color(color));
+			score = -Chess_Game_negamax(state, depth - 1 - reduction, -beta, -beta + 1, ply + 1);
+			Chess_Game_set_side_to_move(game, color);
+			game->last_move = last_move;
+			if (state->stopped){
+				return 0;
+			}
+			if (score >= beta){
+				return is_mate_score(score) ? beta:score;
+			}
+		}
+		
+		//  Futility: quiet moves near the leaves can't make up a large deficit
+		futile = options->futility_pruning && depth <= FUTILITY_DEPTH 
+				 && static_score + FUTILITY_MARGIN * depth <= alpha
+				 && !is_mate_score(alpha);
+	}
+	
+	Chess_Game_generate_legal_moves(game, color, list);
+	if (!list->count){
+		return -MATE_SCORE + ply;
+	}
+	// Search the hash move, then captures, then killers and then other quiet moves
+	Search_State_score_moves(state, ply, hash_move);
+	for (i=0; i<list->count; ++i){
+		pm = Search_State_next_move(state, ply, i);
+		quiet = !packed_move_is_capture(pm) && !packed_move_promotion(pm);
+		Chess_Game_make_move(game, pm);
+		gives_check = Chess_Game_in_check(game, game->side_to_move);
+		
+		// Skip futile quiet moves once something has been searched
+		if (futile && quiet && !gives_check && best_score > -INFINITE_SCORE){
+			Chess_Game_unmake_move(game);
+			continue;
+		}
+		
+		// Principal variation search: the first move is expected to be best, so
+		//  the rest only have to be shown worse with a zero window around alpha.
+		//  Late quiet moves are first searched 1 ply shallower(ordering makes them
+		//  unlikely to matter). A move is searched again at full depth and
+		//  then with the full window when it beats alpha
+		if (i == 0){
+			score = -Chess_Game_negamax(state, depth - 1, -beta, -alpha, ply + 1);
+		}else{
+			reduction = (
+				options->late_move_reductions && quiet && !in_check && !gives_check
+				&& depth >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES && scores[i] < KILLER_SCORE
 			);
-			curr_move = pa.optimal_move(game, i, j, ALL_LOSS);
-			if (curr_move.gain > optimal_move.gain 
-				|| (curr_move.gain == optimal_move.gain 
-					&& rand() % 32 + 1 == 1))
-			{
-				optimal_move = curr_move;
+			score = -Chess_Game_negamax(state, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+			if (score > alpha && reduction){
+				score = -Chess_Game_negamax(state, depth - 1, -alpha - 1, -alpha, ply + 1);
+			}
+			if (score > alpha && score < beta){
+				score = -Chess_Game_negamax(state, depth - 1, -beta, -alpha, ply + 1);
+			}
+		}
+		Chess_Game_unmake_move(game);
+		// A stopped search's scores mean nothing, so nothing is stored
+		if (state->stopped){
+			return 0;
+		}
+		if (score > best_score){
+			best_score = score;
+			best_move = pm;
+			if (score > alpha){
+				alpha = score;
+				Search_State_update_pv(state, ply, pm);
+				if (alpha >= beta){
+					if (quiet){
+						Search_State_reward_quiet(state, ply, depth, pm);
+					}
+					break;
+				}
 			}
 		}
 	}
 	
-	// Simpmly return the move if that is desired
-	if (no_render){
-		return optimal_move;
+	Transposition_Table_store(
+		&transposition_table, game->key, depth,
+		(best_score <= alpha_orig) ? TT_UPPER:(best_score >= beta) ? TT_LOWER:TT_EXACT,
+		score_to_tt(best_score, ply), best_move
+	);
+	if (ply == 0){
+		state->best_move = best_move;
+		state->best_score = best_score;
+	}
+	return best_score;
+}
+
+//    Search the root in a window around the last iteration's score, since the
+//     score rarely moves far between iterations and a narrow window cuts off more.
+//     A score on the window's edge is only a bound, so the window is widened on
+//     that side and the root searched again
+int Chess_Game_aspiration_search(Search_State* state, int depth){
+	int delta = ASPIRATION_WINDOW;
+	int alpha = -INFINITE_SCORE;
+	int beta = INFINITE_SCORE;
+	int score;
+	if (depth >= ASPIRATION_MIN_DEPTH && !is_mate_score(state->best_score)){
+		alpha = state->best_score - delta;
+		beta = state->best_score + delta;
+	}
+	while (true){
+		score = Chess_Game_negamax(state, depth, alpha, beta, 0);
+		if (state->stopped){
+			return score;
+		}
+		if (score <= alpha && alpha > -INFINITE_SCORE){
+			alpha = (score - delta > -INFINITE_SCORE) ? score - delta:-INFINITE_SCORE;
+		}else if (score >= beta && beta < INFINITE_SCORE){
+			beta = (score + delta < INFINITE_SCORE) ? score + delta:INFINITE_SCORE;
+		}else{
+			return score;
+		}
+		delta *= 2;
+	}
+}
+
+//    Search 1 ply deeper each iteration so every iteration's best moves
+//     (kept in the transposition table) order the next one
+Packed_Move Chess_Game_search(Search_State* state, int depth){
+	Packed_Move best_move;
+	int best_score;
+	int i, j, k;
+	state->best_move = NULL_PACKED_MOVE;
+	state->best_score = 0;
+	state->best_pv_length = 0;
+	state->depth = 0;
+	state->nodes = 0;
+	state->stopped = false;
+	for (i=0; i<MAX_PLY; ++i){
+		for (j=0; j<KILLER_COUNT; ++j){
+			state->killers[i][j] = NULL_PACKED_MOVE;
+		}
+	}
+	for (i=0; i<2; ++i){
+		for (j=0; j<SQUARE_COUNT; ++j){
+			for (k=0; k<SQUARE_COUNT; ++k){
+				state->history[i][j][k] = 0;
+			}
+		}
+	}
+	while (state->depth < depth && state->depth + state->depth_offset < MAX_PLY - 1){
+		best_move = state->best_move;
+		best_score = state->best_score;
+		Chess_Game_aspiration_search(state, state->depth + 1 + state->depth_offset);
+		// Keep the last finished iteration's result(a stopped iteration may
+		//  have only finished a search with a window that failed)
+		if (state->stopped){
+			state->best_move = best_move;
+			state->best_score = best_score;
+			break;
+		}
+		++state->depth;
+		for (i=0; i<state->pv_lengths[0]; ++i){
+			state->best_pv[i] = state->pv[0][i];
+		}
+		state->best_pv_length = state->pv_lengths[0];
+		// Searching deeper can't find anything quicker than a mate already in reach
+		if (MATE_SCORE - state->best_score <= state->depth 
+			|| MATE_SCORE + state->best_score <= state->depth)
+		{
+			break;
+		}
+	}
+	return state->best_move;
+}
+
+#ifndef __KERNEL__
+//    Lazy SMP: helper threads search the same root on their own copies of the game
+//     until the main search finishes. They share only the transposition table, so
+//     what they store makes the main search's probes hit more often and cut off sooner.
+//     Every other helper searches 1 ply deeper each iteration so they spread out
+//     over different parts of the tree
+typedef struct Search_Helper{
+	Search_State state; // First so it keeps the struct's cache line alignment
+	Chess_Game game;
+	pthread_t thread;
+	bool running;
+} __attribute__((aligned(CACHE_LINE_SIZE))) Search_Helper;
+
+void* Search_Helper_run(void* arg){
+	Search_Helper* helper = arg;
+	Chess_Game_search(&helper->state, MAX_PLY - 1);
+	return NULL;
+}
+
+//    Start a number of helpers searching a game until stop is set.
+//     Returns NULL when they can't be allocated(the search then runs alone)
+Search_Helper* Search_Helpers_start(
+	Chess_Game* game, const Search_Options* options, int count, const bool* stop
+){
+	Search_Helper* helpers;
+	int i;
+	if (count < 1 || !(helpers = table_alloc(count * sizeof(Search_Helper)))){
+		return NULL;
+	}
+	for (i=0; i<count; ++i){
+		helpers[i].game = *game;
+		helpers[i].state.game = &helpers[i].game;
+		helpers[i].state.options = *options;
+		helpers[i].state.depth_offset = (i + 1) % 2;
+		helpers[i].state.deadline_ns = 0;
+		helpers[i].state.node_limit = 0;
+		helpers[i].state.stop = stop;
+		helpers[i].running = !pthread_create(&helpers[i].thread, NULL, Search_Helper_run, &helpers[i]);
+	}
+	return helpers;
+}
+
+//    Stop and free the helpers, returning how many nodes they searched
+unsigned long long Search_Helpers_stop(Search_Helper* helpers, int count, bool* stop){
+	unsigned long long nodes = 0;
+	int i;
+	if (!helpers){
+		return 0;
+	}
+	__atomic_store_n(stop, true, __ATOMIC_RELAXED);
+	for (i=0; i<count; ++i){
+		if (helpers[i].running){
+			pthread_join(helpers[i].thread, NULL);
+			nodes += helpers[i].state.nodes;
+		}
+	}
+	table_free(helpers);
+	return nodes;
+}
+#endif
+
+//    Choose(and unless no_render is set, render) a move for a color.
+//     Options default to Search_Options_init0 when NULL and the
+//     report is only filled in when given
+Packed_Move Chess_Game_cpu_move(
+	Chess_Game* game, char color, bool no_render, 
+	const Search_Options* options, Search_Report* report
+){
+	Search_Report result = {0};
+	unsigned long long start_ns = monotonic_ns();
+	Search_State* state = table_alloc(sizeof(Search_State));
+#ifndef __KERNEL__
+	Search_Helper* helpers = NULL;
+	bool stop_helpers = false;
+#endif
+	// Search from this color's point of view
+	Chess_Game_set_side_to_move(game, color);
+	// Results cached by earlier searches are now older
+	Transposition_Table_new_search(&transposition_table);
+	
+	// Find the best move, falling back to the greedy choice when 
+	//  there's no memory to search with
+	if (state){
+		state->game = game;
+		state->options = options ? *options:Search_Options_init0();
+		state->depth_offset = 0;
+		state->deadline_ns = state->options.time_limit_ms 
+							 ? start_ns + state->options.time_limit_ms * 1000000ULL:0;
+		state->node_limit = state->options.node_limit;
+		state->stop = state->options.stop;
+#ifndef __KERNEL__
+		helpers = Search_Helpers_start(game, &state->options, state->options.threads - 1, &stop_helpers);
+#endif
+		result.best_move = Chess_Game_search(
+			state, (state->options.depth < MAX_SEARCH_DEPTH) ? state->options.depth:MAX_SEARCH_DEPTH
+		);
+		result.score = state->best_score;
+		result.depth = state->depth;
+		result.nodes = state->nodes;
+#ifndef __KERNEL__
+		result.nodes += Search_Helpers_stop(helpers, state->options.threads - 1, &stop_helpers);
+#endif
+		for (result.pv_length=0; result.pv_length<state->best_pv_length; ++result.pv_length){
+			result.pv[result.pv_length] = state->best_pv[result.pv_length];
+		}
+		table_free(state);
+	}else{
+		result.best_move = Chess_Game_greedy_move(game, color);
+	}
+	result.time_ms = (monotonic_ns() - start_ns) / 1000000;
+	if (report){
+		*report = result;
+	}
+	
+	// Render the move unless only the choice of move is wanted
+	if (!no_render){
+		Chess_Game_render_packed_move(game, result.best_move, false, color);
 	}
 	
-	// Simulate and return the result
-	return Chess_Game_render_move(game, optimal_move, false, color, false);
+	return result.best_move;
 }
 
 #endif //CHESS_C
@@ -0,0 +1,317 @@
+#include "chess.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Usage: ./perft [-t threads] [-H hash_mb] [-s] [-p] <depth> [placement] [side]
+//  Counts the leaf nodes of the legal move tree to the given depth and prints
+//  each root move's share of them("divide") followed by the total and nodes per second.
+//  The position defaults to the start position with white to move. Otherwise it is
+//  given as the piece placement field of a FEN(e.g. "8/8/8/8/8/8/8/R3K2k")
+//  followed by 'w' or 'b' for the side to move
+//   -t: number of threads the root moves are split across(defaults to the core count)
+//   -H: megabytes of subtree count cache shared by the threads(0 disables it)
+//   -s: instead report how throughput scales from 1 thread up to the -t count
+//   -p: generate moves with the pseudo-legal generator, dropping those that leave
+//    the mover in check, so its counts can be checked against the legal generator's
+
+#define DEFAULT_HASH_MB 64
+#define MAX_THREADS 256
+
+// Subtree count cache shared by every thread(keyed by the games' Zobrist keys).
+//  Entries are written without locks, so each stores its key XORed with its data
+//  and a torn entry(one thread's key with another's data) fails the check
+typedef struct Perft_Entry{
+	unsigned long long check; // key ^ data
+	unsigned long long data; // nodes << 8 | depth
+} Perft_Entry;
+
+Perft_Entry* cache = NULL;
+unsigned long long cache_mask = 0;
+bool pseudo_legal = false;
+
+bool cache_probe(unsigned long long key, int depth, unsigned long long* nodes){
+	Perft_Entry* entry = &cache[key & cache_mask];
+	unsigned long long check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	unsigned long long data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+	if ((check ^ data) != key || (int)(data & 0xFF) != depth){
+		return false;
+	}
+	*nodes = data >> 8;
+	return true;
+}
+
+void cache_store(unsigned long long key, int depth, unsigned long long nodes){
+	Perft_Entry* entry = &cache[key & cache_mask];
+	unsigned long long data = (nodes << 8) | depth;
+	__atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+//  Print a move in coordinate notation(e.g. e2e4 or a7a8q)
+void print_move(Packed_Move pm){
+	char coordinates[COORDINATE_NOTATION_LENGTH + 1];
+	Packed_Move_coordinates(pm, coordinates);
+	printf("%s", coordinates);
+}
+
+//  Fill a list with a color's legal moves from the generator chosen by -p
+void generate_moves(Chess_Game* game, char color, Move_List* list){
+	Move_List pseudo_legal_moves;
+	int i;
+	if (!pseudo_legal){
+		Chess_Game_generate_legal_moves(game, color, list);
+		return;
+	}
+	Chess_Game_generate_moves(game, color, &pseudo_legal_moves);
+	list->count = 0;
+	for (i=0; i<pseudo_legal_moves.count; ++i){
+		Chess_Game_make_move(game, pseudo_legal_moves.moves[i]);
+		if (!Chess_Game_in_check(game, color)){
+			list->moves[list->count++] = pseudo_legal_moves.moves[i];
+		}
+		Chess_Game_unmake_move(game);
+	}
+}
+
+unsigned long long perft(Chess_Game* game, char color, int depth){
+	Move_List list;
+	unsigned long long nodes = 0;
+	unsigned long long key = 0;
+	int i;
+	// Subtrees already counted are looked up. The last ply is too cheap to cache
+	if (cache && depth > 1){
+		key = game->key;
+		if (cache_probe(key, depth, &nodes)){
+			return nodes;
+		}
+	}
+	generate_moves(game, color, &list);
+	// The last ply only needs the number of moves
+	if (depth == 1){
+		return list.count;
+	}
+	for (i=0; i<list.count; ++i){
+		Chess_Game_make_move(game, list.moves[i]);
+		nodes += perft(game, other_color(color), depth - 1);
+		Chess_Game_unmake_move(game);
+	}
+	if (cache){
+		cache_store(key, depth, nodes);
+	}
+	return nodes;
+}
+
+// Thread pool with work stealing.
+//  Root moves are dealt out evenly to the threads' queues. A thread works
+//  through its own queue from the back and, once it is empty, steals
+//  from the front of the other threads' queues
+typedef struct Task_Queue{
+	pthread_mutex_t lock;
+	int tasks[MAX_MOVES]; // Indices into the root move list
+	int front;
+	int back;
+} Task_Queue;
+
+typedef struct Worker{
+	pthread_t thread;
+	Chess_Game game; // Each thread works on its own copy
+	Task_Queue queue;
+} Worker;
+
+typedef struct Perft_Job{
+	Worker* workers;
+	int worker_count;
+	Move_List root_moves;
+	unsigned long long move_nodes[MAX_MOVES];
+	char color;
+	int depth;
+} Perft_Job;
+
+typedef struct Worker_Args{
+	Perft_Job* job;
+	int index;
+} Worker_Args;
+
+//  Take a task from the back(own queue) or the front(stealing). Returns -1 when empty
+int Task_Queue_pop(Task_Queue* queue, bool steal){
+	int task = -1;
+	pthread_mutex_lock(&queue->lock);
+	if (queue->front < queue->back){
+		task = steal ? queue->tasks[queue->front++]:queue->tasks[--queue->back];
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return task;
+}
+
+void* worker_run(void* arg){
+	Worker_Args* args = arg;
+	Perft_Job* job = args->job;
+	Worker* self = &job->workers[args->index];
+	Packed_Move pm;
+	int task;
+	int i;
+	while (true){
+		// Prefer own work, otherwise steal from the other threads in turn
+		task = Task_Queue_pop(&self->queue, false);
+		for (i=1; task < 0 && i<job->worker_count; ++i){
+			task = Task_Queue_pop(&job->workers[(args->index + i) % job->worker_count].queue, true);
+		}
+		if (task < 0){
+			return NULL;
+		}
+		pm = job->root_moves.moves[task];
+		Chess_Game_make_move(&self->game, pm);
+		job->move_nodes[task] = (job->depth == 1)
+								? 1:perft(&self->game, other_color(job->color), job->depth - 1);
+		Chess_Game_unmake_move(&self->game);
+	}
+}
+
+//  Count the nodes under every root move with the given number of threads
+unsigned long long run_perft(Perft_Job* job, Chess_Game* game, int thread_count){
+	Worker workers[MAX_THREADS];
+	Worker_Args args[MAX_THREADS];
+	unsigned long long nodes = 0;
+	int i;
+	job->workers = workers;
+	job->worker_count = thread_count;
+	for (i=0; i<thread_count; ++i){
+		workers[i].game = *game;
+		pthread_mutex_init(&workers[i].queue.lock, NULL);
+		workers[i].queue.front = workers[i].queue.back = 0;
+	}
+	for (i=0; i<job->root_moves.count; ++i){
+		Task_Queue* queue = &workers[i % thread_count].queue;
+		queue->tasks[queue->back++] = i;
+	}
+	for (i=0; i<thread_count; ++i){
+		args[i].job = job;
+		args[i].index = i;
+		pthread_create(&workers[i].thread, NULL, worker_run, &args[i]);
+	}
+	for (i=0; i<thread_count; ++i){
+		pthread_join(workers[i].thread, NULL);
+		pthread_mutex_destroy(&workers[i].queue.lock);
+	}
+	for (i=0; i<job->root_moves.count; ++i){
+		nodes += job->move_nodes[i];
+	}
+	return nodes;
+}
+
+double seconds_since(struct timespec* start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv){
+	Chess_Game game;
+	Perft_Job job;
+	long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	long hash_mb = DEFAULT_HASH_MB;
+	unsigned long long entry_count;
+	bool scaling = false;
+	unsigned long long nodes;
+	struct timespec start;
+	double seconds;
+	double base_seconds = 0;
+	int option;
+	int threads;
+	int i;
+
+	Chess_Game_init(&game, WHITE, BLACK);
+
+	// Parse the arguments
+	while ((option = getopt(argc, argv, "t:H:sp")) != -1){
+		switch (option){
+			case 't': thread_count = atol(optarg); break;
+			case 'H': hash_mb = atol(optarg); break;
+			case 's': scaling = true; break;
+			case 'p': pseudo_legal = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-t threads] [-H hash_mb] [-s] [-p] <depth> [placement] [w|b]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind >= argc || argc - optind > 3){
+		fprintf(stderr, "Usage: %s [-t threads] [-H hash_mb] [-s] [-p] <depth> [placement] [w|b]\n", argv[0]);
+		return 1;
+	}
+	job.depth = atoi(argv[optind]);
+	job.color = WHITE;
+	if (job.depth < 1 || job.depth > UNDO_STACK_SIZE){
+		fprintf(stderr, "Depth must be between 1 and %d\n", UNDO_STACK_SIZE);
+		return 1;
+	}
+	if (thread_count < 1 || thread_count > MAX_THREADS){
+		fprintf(stderr, "Threads must be between 1 and %d\n", MAX_THREADS);
+		return 1;
+	}
+	if (argc - optind > 1 && !Chess_Game_load_placement(&game, argv[optind + 1])){
+		fprintf(stderr, "Invalid placement: %s\n", argv[optind + 1]);
+		return 1;
+	}
+	if (argc - optind > 2){
+		job.color = (argv[optind + 2][0] == 'b') ? BLACK:WHITE;
+	}
+	Chess_Game_set_side_to_move(&game, job.color);
+
+	// Set up the cache with a power of 2 number of entries
+	if (hash_mb > 0){
+		for (entry_count=1; entry_count * 2 * sizeof(Perft_Entry) <= (unsigned long long)hash_mb << 20; entry_count *= 2){}
+		cache_mask = entry_count - 1;
+		if (!(cache = malloc(entry_count * sizeof(Perft_Entry)))){
+			perror("Could not allocate the cache");
+			return 1;
+		}
+	}
+	generate_moves(&game, job.color, &job.root_moves);
+
+	// Report throughput for every thread count from 1 up.
+	//  The cache is cleared before each run so they all do the same work
+	if (scaling){
+		printf("Threads  Nodes            Time(s)   Nodes/second    Speedup\n");
+		for (threads=1; threads<=thread_count; ++threads){
+			if (cache){
+				memset(cache, 0, (cache_mask + 1) * sizeof(Perft_Entry));
+			}
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			nodes = run_perft(&job, &game, threads);
+			seconds = seconds_since(&start);
+			base_seconds = (threads == 1) ? seconds:base_seconds;
+			printf(
+				"%-8d %-16llu %-9.3f %-15.0f %.2fx\n",
+				threads, nodes, seconds, (seconds > 0) ? nodes / seconds:0.0,
+				(seconds > 0) ? base_seconds / seconds:1.0
+			);
+		}
+		free(cache);
+		return 0;
+	}
+
+	// Divide the count among the root moves
+	if (cache){
+		memset(cache, 0, (cache_mask + 1) * sizeof(Perft_Entry));
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	nodes = run_perft(&job, &game, thread_count);
+	seconds = seconds_since(&start);
+	for (i=0; i<job.root_moves.count; ++i){
+		print_move(job.root_moves.moves[i]);
+		printf(": %llu\n", job.move_nodes[i]);
+	}
+
+	// Report the totals
+	printf("\nNodes: %llu\n", nodes);
+	printf("Threads: %ld\n", thread_count);
+	printf("Time: %.3fs\n", seconds);
+	printf("Nodes/second: %.0f\n", (seconds > 0) ? nodes / seconds:0.0);
+	free(cache);
+	return 0;
+}
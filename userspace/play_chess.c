@@ -4,6 +4,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
 
 bool streq(const char* s, const char* s2, int start, int end){
 	int i = start;
@@ -11,8 +13,123 @@ bool streq(const char* s, const char* s2, int start, int end){
 	return (i == end || (!s[i] && !s2[i]));
 }
 
-int main(){
+// Pondering: once the CPU has moved, a thread searches on while the player thinks.
+//  It searches the position the CPU's principal variation expects the player to 
+//  leave or, without a prediction, the player's own position so the transposition 
+//  table fills with answers to all their replies. When the player's move leaves the 
+//  predicted position the search is kept and answers the next "03", otherwise it's
+//  stopped and only what it left in the transposition table helps
+#define PONDER_POLL_NS 1000000 // How often a finishing ponder is checked on
+#define PONDER_TIME_FACTOR 4 // Move times a ponder may search for
+
+typedef struct Ponder{
+	pthread_t thread;
+	bool running;
+	bool stop;
+	bool finished; // Set by the thread once its search returns
+	Chess_Game game; // The thread's own copy
+	char color; // That the thread searches for
+	unsigned long long key; // Of the predicted position(0 when there's no prediction)
+	Search_Options options;
+	Search_Report report;
+	unsigned long long start_ns;
+} Ponder;
+
+void* Ponder_run(void* arg){
+	Ponder* ponder = arg;
+	Chess_Game_cpu_move(&ponder->game, ponder->color, true, &ponder->options, &ponder->report);
+	__atomic_store_n(&ponder->finished, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+//  Start pondering after the CPU's move, given the report of the search that chose it
+void Ponder_start(
+	Ponder* ponder, Chess_Game* game, char cpu_color, 
+	const Search_Options* options, const Search_Report* report
+){
+	ponder->game = *game;
+	ponder->key = 0;
+	ponder->color = game->player_color;
+	if (report->pv_length > 1 
+		&& Chess_Game_render_packed_move(&ponder->game, report->pv[1], true, ponder->color))
+	{
+		ponder->key = ponder->game.key;
+		ponder->color = cpu_color;
+	}
+	// Searches bounded by depth or nodes keep their bound. A time limited one may
+	//  search a few times as long as a move would, so a hit can answer at once 
+	//  without an idle prompt keeping every search thread busy for good
+	ponder->options = *options;
+	ponder->options.time_limit_ms = options->time_limit_ms * PONDER_TIME_FACTOR;
+	ponder->options.stop = &ponder->stop;
+	ponder->stop = ponder->finished = false;
+	ponder->start_ns = monotonic_ns();
+	ponder->running = !pthread_create(&ponder->thread, NULL, Ponder_run, ponder);
+}
+
+//  Stop pondering and wait for the thread
+void Ponder_stop(Ponder* ponder){
+	if (ponder->running){
+		__atomic_store_n(&ponder->stop, true, __ATOMIC_RELAXED);
+		pthread_join(ponder->thread, NULL);
+		ponder->running = false;
+	}
+}
+
+//  Check if pondering is searching the game's position(the player's move was predicted)
+bool Ponder_hit(Ponder* ponder, Chess_Game* game){
+	return ponder->running && ponder->key && ponder->key == game->key;
+}
+
+//  Finish pondering on a predicted position, returning its move once it has searched as
+//   long as the CPU's move would(NULL_PACKED_MOVE if it didn't finish an iteration)
+Packed_Move Ponder_finish(Ponder* ponder, const Search_Options* options, Search_Report* report){
+	unsigned long long deadline_ns = ponder->start_ns + options->time_limit_ms * 1000000ULL;
+	const struct timespec poll_interval = {0, PONDER_POLL_NS};
+	// A time limited search is given what's left of the limit, unless it ends
+	//  sooner(e.g. on finding a mate). Otherwise the search ends at the CPU's 
+	//  depth or node limit by itself
+	if (options->time_limit_ms){
+		while (!__atomic_load_n(&ponder->finished, __ATOMIC_ACQUIRE) && monotonic_ns() < deadline_ns){
+			nanosleep(&poll_interval, NULL);
+		}
+		Ponder_stop(ponder);
+	}else{
+		pthread_join(ponder->thread, NULL);
+		ponder->running = false;
+	}
+	*report = ponder->report;
+	return (report->depth > 0) ? report->best_move:NULL_PACKED_MOVE;
+}
+
+// Usage: ./play_chess [hash_mb] [threads] [move_ms] [ponder]
+//  hash_mb is the size of the transposition table in megabytes(0 disables it)
+//  threads is how many threads search the CPU's moves(defaults to the core count)
+//  move_ms bounds each CPU move's search in milliseconds. The search then deepens
+//   until time runs out instead of stopping at the default depth
+//  ponder is 0 to stop the CPU searching during the player's turn(on by default)
+int main(int argc, char** argv){
 	// Setup
+	//  Size the transposition table
+	if (!Transposition_Table_init(
+			&transposition_table, (argc > 1) ? strtoul(argv[1], NULL, 10):TT_DEFAULT_MB
+		))
+	{
+		perror("Could not allocate the transposition table");
+		return 1;
+	}
+	//  Choose how the CPU searches
+	Search_Options search_options = Search_Options_init0();
+	search_options.threads = (argc > 2) ? atoi(argv[2]):sysconf(_SC_NPROCESSORS_ONLN);
+	if (search_options.threads < 1){
+		search_options.threads = 1;
+	}
+	if (argc > 3 && (search_options.time_limit_ms = strtoul(argv[3], NULL, 10))){
+		search_options.depth = MAX_SEARCH_DEPTH;
+	}
+	bool pondering = (argc > 4) ? atoi(argv[4]):true;
+	Ponder ponder = {.running = false};
+	Search_Report report;
 	bool debug = false;
 	Chess_Game game;
 	bool game_started = false;
@@ -72,6 +189,7 @@ int main(){
 		
 		// Handle resignation and quiting
 		if (streq(input_buff, "04", 0, cmd_len)){
+			Ponder_stop(&ponder);
 			printf("OK\n");
 			game_started = false;
 		}else if (streq(input_buff, "quit", 0, cmd_len)){
@@ -83,8 +201,18 @@ int main(){
 		else if (streq(input_buff, "03", 0, 2)){
 			if (game_started){
 				if (turn == cpu_turn){
-					// Perform the CPU's move
-					Move m = Chess_Game_cpu_move(&game, cpu_color, false);
+					// Perform the CPU's move, notating it before it changes the board.
+					//  When pondering already searched this position its move is used
+					Packed_Move pm = NULL_PACKED_MOVE;
+					if (Ponder_hit(&ponder, &game)){
+						pm = Ponder_finish(&ponder, &search_options, &report);
+					}
+					Ponder_stop(&ponder);
+					if (pm == NULL_PACKED_MOVE){
+						pm = Chess_Game_cpu_move(&game, cpu_color, true, &search_options, &report);
+					}
+					Move m = Chess_Game_notate_move(&game, pm);
+					Chess_Game_render_packed_move(&game, pm, false, cpu_color);
 					printf("Opponent's move: %s\n", m.notation);
 					Chess_Game_print(&game);
 					
@@ -108,6 +236,11 @@ int main(){
 					
 					// Increment turn
 					turn = (turn + 1) % 2;
+
+					// Think on while the player does
+					if (pondering && game_started){
+						Ponder_start(&ponder, &game, cpu_color, &search_options, &report);
+					}
 				}else{
 					printf("OOT\n");
 				}
@@ -133,6 +266,10 @@ int main(){
 					}
 					m = Chess_Game_render_move(&game, m, no_self_check, player_color, true);
 					Chess_Game_print(&game);
+					// Pondering on any other position is of no more use
+					if (m.subject_color != NO_COLOR && !Ponder_hit(&ponder, &game)){
+						Ponder_stop(&ponder);
+					}
 
 					// Handle the result of the move e.g. ILLMOVE errors or post-move game status
 					if (m.subject_color == NO_COLOR){
@@ -182,11 +319,12 @@ int main(){
 				printf("ILLMOVE\n");
 			}else{
 				if (is_valid_color(input_buff[3])){
+					Ponder_stop(&ponder);
 					game_started = true;
 					player_color = input_buff[3];
 					cpu_color = other_color(input_buff[3]);
 					turn = 0;
-					game = Chess_Game_init2(player_color, cpu_color);
+					Chess_Game_init(&game, player_color, cpu_color);
 					{// Determine if we're playing with no self checks
 						printf("Prohibit self-checks(y/n)?: ");
 						if (!fgets(input_buff, 2, stdin)){
@@ -210,6 +348,8 @@ int main(){
 	}
 	
 	printf("Stopping...\n");
+	Ponder_stop(&ponder);
+	Transposition_Table_free(&transposition_table);
 	
 	return 0;
 }